@@ -22,6 +22,7 @@
 #include "defs.h"
 #include "fs.h"
 #include "buf.h"
+#include "trace.h"
 
 struct {
   struct spinlock lock;
@@ -88,15 +89,43 @@ bget(uint dev, uint blockno)
   panic("bget: no buffers");
 }
 
+// Read or write b on the disk device: the RAM disk
+// if there is one, otherwise the virtio disk.
+static void
+brw(struct buf *b, int write)
+{
+  if(ramdisk)
+    ramdiskrw(b, write);
+  else
+    virtio_disk_rw(b, write);
+}
+
 // Return a locked buf with the contents of the indicated block.
 struct buf*
 bread(uint dev, uint blockno)
 {
   struct buf *b;
 
+  b = bget(dev, blockno);
+  ktrace(TR_BREAD, blockno, b->valid);
+  if(!b->valid) {
+    brw(b, 0);
+    b->valid = 1;
+  }
+  return b;
+}
+
+// Return a locked buf for a block that the caller is about
+// to overwrite completely.  If the block isn't cached, its
+// old contents aren't read from disk; the data is zeroed.
+struct buf*
+bblank(uint dev, uint blockno)
+{
+  struct buf *b;
+
   b = bget(dev, blockno);
   if(!b->valid) {
-    virtio_disk_rw(b, 0);
+    memset(b->data, 0, BSIZE);
     b->valid = 1;
   }
   return b;
@@ -108,7 +137,8 @@ bwrite(struct buf *b)
 {
   if(!holdingsleep(&b->lock))
     panic("bwrite");
-  virtio_disk_rw(b, 1);
+  ktrace(TR_BWRITE, b->blockno, 0);
+  brw(b, 1);
 }
 
 // Release a locked buffer.
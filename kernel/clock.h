@@ -0,0 +1,20 @@
+// clock_gettime() and the clock page.
+// Both the kernel and user programs use this header file.
+
+#define CLOCK_MONOTONIC 1  // nanoseconds since boot
+
+// the clock page, mapped read-only at CLOCKPAGE in every
+// process.  with it, user code can turn the time CSR,
+// which it may read, into nanoseconds without a system call.
+struct clockpage {
+  uint64 freq;      // time CSR counts per second
+  uint64 boottime;  // time CSR at boot
+};
+
+// nanoseconds in t counts of a clock running at freq
+// per second, without overflowing for any t.
+static inline uint64
+clockns(uint64 t, uint64 freq)
+{
+  return (t / freq) * 1000000000 + (t % freq) * 1000000000 / freq;
+}
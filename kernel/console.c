@@ -21,6 +21,7 @@
 #include "riscv.h"
 #include "defs.h"
 #include "proc.h"
+#include "poll.h"
 
 #define BACKSPACE 0x100
 #define C(x)  ((x)-'@')  // Control-x
@@ -52,6 +53,23 @@ struct {
   uint e;  // Edit index
 } cons;
 
+//
+// poll() readiness: input is readable once a whole line
+// (or ^D) has arrived; output never blocks for long.
+//
+int
+consolepoll(void)
+{
+  int r = POLLOUT;
+
+  acquire(&cons.lock);
+  pollwait(&cons.r);
+  if(cons.r != cons.w)
+    r |= POLLIN;
+  release(&cons.lock);
+  return r;
+}
+
 //
 // user write()s to the console go here.
 //
@@ -191,4 +209,5 @@ consoleinit(void)
   // to consoleread and consolewrite.
   devsw[CONSOLE].read = consoleread;
   devsw[CONSOLE].write = consolewrite;
+  devsw[CONSOLE].poll = consolepoll;
 }
@@ -1,17 +1,22 @@
 struct buf;
+struct clockpage;
 struct context;
 struct file;
 struct inode;
+struct dentry;
 struct pipe;
 struct proc;
 struct spinlock;
 struct sleeplock;
 struct stat;
+struct iovec;
 struct superblock;
+struct sysstat;
 
 // bio.c
 void            binit(void);
 struct buf*     bread(uint, uint);
+struct buf*     bblank(uint, uint);
 void            brelse(struct buf*);
 void            bwrite(struct buf*);
 void            bpin(struct buf*);
@@ -33,11 +38,25 @@ void            fileinit(void);
 int             fileread(struct file*, uint64, int n);
 int             filestat(struct file*, uint64 addr);
 int             filewrite(struct file*, uint64, int n);
+int             filereadv(struct file*, struct iovec*, int);
+int             filewritev(struct file*, struct iovec*, int);
+int             filepread(struct file*, uint64, int, uint);
+int             filepwrite(struct file*, uint64, int, uint);
+int             fileseek(struct file*, int, int);
+int             filepoll(struct file*);
+int             filegetdents(struct file*, uint64, int, int);
+int             filesplice(struct file*, struct file*, int n);
 
 // fs.c
 void            fsinit(int);
+void            bcommitted(void);
+int             iwritemax(struct inode*);
+int             mount(struct inode*, uint);
+int             ismountpoint(struct inode*);
 int             dirlink(struct inode*, char*, uint);
 struct inode*   dirlookup(struct inode*, char*, uint*);
+struct inode*   dentryget(struct inode*, struct dentry*);
+void            dentrystat(struct inode*, struct dentry*, struct inode*);
 struct inode*   ialloc(uint, short);
 struct inode*   idup(struct inode*);
 void            iinit();
@@ -55,15 +74,28 @@ int             writei(struct inode*, int, uint64, uint, uint);
 void            itrunc(struct inode*);
 
 // ramdisk.c
+extern char     *ramdisk;
 void            ramdiskinit(void);
-void            ramdiskintr(void);
-void            ramdiskrw(struct buf*);
+void            ramdiskrw(struct buf*, int);
+
+// ioring.c
+int             ringdrain(void);
+uint64          ringsetup(int);
+void            ringfree(pagetable_t);
 
 // kalloc.c
 void*           kalloc(void);
 void            kfree(void *);
+void*           kallocorder(int);
+void            kfreeorder(void *, int);
 void            kinit(void);
 
+// slab.c
+void            slabinit(void);
+void*           kmalloc(uint);
+void            kmfree(void*);
+int             slabreclaim(void);
+
 // log.c
 void            initlog(int, struct superblock*);
 void            log_write(struct buf*);
@@ -75,6 +107,13 @@ int             pipealloc(struct file**, struct file**);
 void            pipeclose(struct pipe*, int);
 int             piperead(struct pipe*, uint64, int);
 int             pipewrite(struct pipe*, uint64, int);
+int             pipesize(struct pipe*);
+int             pipesetsize(struct pipe*, int);
+int             pipepoll(struct pipe*, int, int);
+int             pipewbegin(struct pipe*, char**);
+void            pipewend(struct pipe*, int);
+int             piperbegin(struct pipe*, char**, int);
+void            piperend(struct pipe*, int);
 
 // printf.c
 void            printf(char*, ...);
@@ -100,14 +139,29 @@ void            sleep(void*, struct spinlock*);
 void            userinit(void);
 int             wait(uint64);
 void            wakeup(void*);
+void            pollwait(void*);
+void            pollclear(void);
+void            pollsleep(int, uint64);
 void            yield(void);
 int             either_copyout(int user_dst, uint64 dst, void *src, uint64 len);
 int             either_copyin(void *dst, int user_src, uint64 src, uint64 len);
 void            procdump(void);
 
+// tmpfs.c
+void            tmpfsinit(void);
+
+// trace.c
+void            traceinit(void);
+void            ktrace(int, uint64, uint64);
+int             tracectl(int);
+int             traceread(uint64, int);
+
 // swtch.S
 void            swtch(struct context*, struct context*);
 
+// sysfile.c
+int             fileopen(char*, int);
+
 // spinlock.c
 void            acquire(struct spinlock*);
 int             holding(struct spinlock*);
@@ -137,6 +191,7 @@ int             argstr(int, char*, int);
 int             argaddr(int, uint64 *);
 int             fetchstr(uint64, char*, int);
 int             fetchaddr(uint64, uint64*);
+int             sysstatread(int, int, struct sysstat*);
 void            syscall();
 
 // trap.c
@@ -145,6 +200,11 @@ void            trapinit(void);
 void            trapinithart(void);
 extern struct spinlock tickslock;
 void            usertrapret(void);
+uint            tickcount(void);
+extern struct clockpage *clockpage;
+void            timerarm(void);
+void            timerwait(uint64);
+void            ipi(int);
 
 // uart.c
 void            uartinit(void);
@@ -158,6 +218,13 @@ void            kvminit(void);
 void            kvminithart(void);
 uint64          kvmpa(uint64);
 void            kvmmap(uint64, uint64, uint64, int);
+pagetable_t     kvmcreate(void);
+void            kvmfree(pagetable_t);
+void            kvmsync(struct proc*);
+void            asidinit(void);
+void            kvmswitch(struct proc*);
+void            uvmflush(struct proc*);
+void            uvmflushpage(struct proc*, uint64);
 int             mappages(pagetable_t, uint64, uint64, uint64, int);
 pagetable_t     uvmcreate(void);
 void            uvminit(pagetable_t, uchar *, uint);
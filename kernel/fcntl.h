@@ -3,3 +3,14 @@
 #define O_RDWR    0x002
 #define O_CREATE  0x200
 #define O_TRUNC   0x400
+
+// lseek() whence
+#define SEEK_SET 0  // offset from the start of the file
+#define SEEK_CUR 1  // from the current offset
+#define SEEK_END 2  // from the end of the file
+
+// fcntl() commands
+#define F_GETPIPE_SZ 1  // return pipe capacity in bytes
+#define F_SETPIPE_SZ 2  // resize pipe to hold at least arg bytes
+
+#define GD_STAT 0x1  // getdents(): fill in type and size
@@ -12,11 +12,16 @@
 #include "file.h"
 #include "stat.h"
 #include "proc.h"
+#include "poll.h"
+#include "iovec.h"
+#include "fcntl.h"
 
 struct devsw devsw[NDEV];
+// file structs come from kmalloc(); ftable just counts
+// them, to keep at most NFILE open at once.
 struct {
   struct spinlock lock;
-  struct file file[NFILE];
+  int nfile;
 } ftable;
 
 void
@@ -32,15 +37,22 @@ filealloc(void)
   struct file *f;
 
   acquire(&ftable.lock);
-  for(f = ftable.file; f < ftable.file + NFILE; f++){
-    if(f->ref == 0){
-      f->ref = 1;
-      release(&ftable.lock);
-      return f;
-    }
+  if(ftable.nfile >= NFILE){
+    release(&ftable.lock);
+    return 0;
   }
+  ftable.nfile++;
   release(&ftable.lock);
-  return 0;
+
+  if((f = kmalloc(sizeof(*f))) == 0){
+    acquire(&ftable.lock);
+    ftable.nfile--;
+    release(&ftable.lock);
+    return 0;
+  }
+  memset(f, 0, sizeof(*f));
+  f->ref = 1;
+  return f;
 }
 
 // Increment ref count for file f.
@@ -69,9 +81,9 @@ fileclose(struct file *f)
     return;
   }
   ff = *f;
-  f->ref = 0;
-  f->type = FD_NONE;
+  ftable.nfile--;
   release(&ftable.lock);
+  kmfree(f);
 
   if(ff.type == FD_PIPE){
     pipeclose(ff.pipe, ff.writable);
@@ -129,12 +141,45 @@ fileread(struct file *f, uint64 addr, int n)
   return r;
 }
 
+// Write n bytes from user address addr to inode ip at *off,
+// advancing *off.
+static int
+inodewrite(struct inode *ip, uint64 addr, int n, uint *off)
+{
+  int r, i;
+
+  // write a few blocks at a time to avoid exceeding
+  // the maximum log transaction size; iwritemax() says
+  // how much fits.  regular file data isn't logged, so
+  // for those one transaction usually does.
+  i = 0;
+  while(i < n){
+    int n1 = n - i;
+
+    begin_op();
+    ilock(ip);
+    if(n1 > iwritemax(ip))
+      n1 = iwritemax(ip);
+    if ((r = writei(ip, 1, addr + i, *off, n1)) > 0)
+      *off += r;
+    iunlock(ip);
+    end_op();
+
+    if(r < 0)
+      break;
+    if(r != n1)
+      panic("short filewrite");
+    i += r;
+  }
+  return i == n ? n : -1;
+}
+
 // Write to file f.
 // addr is a user virtual address.
 int
 filewrite(struct file *f, uint64 addr, int n)
 {
-  int r, ret = 0;
+  int ret = 0;
 
   if(f->writable == 0)
     return -1;
@@ -146,37 +191,293 @@ filewrite(struct file *f, uint64 addr, int n)
       return -1;
     ret = devsw[f->major].write(1, addr, n);
   } else if(f->type == FD_INODE){
-    // write a few blocks at a time to avoid exceeding
-    // the maximum log transaction size, including
-    // i-node, indirect block, allocation blocks,
-    // and 2 blocks of slop for non-aligned writes.
-    // this really belongs lower down, since writei()
-    // might be writing a device like the console.
-    int max = ((MAXOPBLOCKS-1-1-2) / 2) * BSIZE;
-    int i = 0;
-    while(i < n){
-      int n1 = n - i;
-      if(n1 > max)
-        n1 = max;
+    ret = inodewrite(f->ip, addr, n, &f->off);
+  } else {
+    panic("filewrite");
+  }
 
-      begin_op();
-      ilock(f->ip);
-      if ((r = writei(f->ip, 1, addr + i, f->off, n1)) > 0)
-        f->off += r;
+  return ret;
+}
+
+// Read from file f at offset off, leaving f->off alone.
+// addr is a user virtual address.
+int
+filepread(struct file *f, uint64 addr, int n, uint off)
+{
+  int r;
+
+  if(f->readable == 0 || f->type != FD_INODE)
+    return -1;
+  ilock(f->ip);
+  r = readi(f->ip, 1, addr, off, n);
+  iunlock(f->ip);
+  return r;
+}
+
+// Write to file f at offset off, leaving f->off alone.
+// addr is a user virtual address.
+int
+filepwrite(struct file *f, uint64 addr, int n, uint off)
+{
+  if(f->writable == 0 || f->type != FD_INODE)
+    return -1;
+  return inodewrite(f->ip, addr, n, &off);
+}
+
+// Set f->off relative to the start (SEEK_SET), the current
+// offset (SEEK_CUR) or the end (SEEK_END) of the file.
+// Returns the new offset.
+int
+fileseek(struct file *f, int off, int whence)
+{
+  int base;
+
+  if(f->type != FD_INODE)
+    return -1;
+  ilock(f->ip);
+  if(whence == SEEK_SET)
+    base = 0;
+  else if(whence == SEEK_CUR)
+    base = f->off;
+  else if(whence == SEEK_END)
+    base = f->ip->size;
+  else
+    base = -1;
+  if(base < 0 || base + off < 0){
+    iunlock(f->ip);
+    return -1;
+  }
+  f->off = base + off;
+  iunlock(f->ip);
+  return f->off;
+}
+
+// Read up to n entries of directory f into the user array
+// of struct dentry at addr, skipping unused slots.  Entries
+// are gathered a batch at a time under the directory lock,
+// which is dropped before GD_STAT looks at their inodes
+// ("." is the directory itself); GD_STAT takes references
+// to the inodes under the lock, so a racing unlink can't
+// free them first.  Returns the number of entries, 0 at
+// the end of the directory.
+#define NDENTBATCH 8
+int
+filegetdents(struct file *f, uint64 addr, int n, int flags)
+{
+  struct dentry d[NDENTBATCH];
+  struct inode *ip[NDENTBATCH];
+  struct dirent de;
+  int i, m, tot;
+
+  if(f->type != FD_INODE || f->readable == 0 || n < 0)
+    return -1;
+
+  for(tot = 0; tot < n; tot += m){
+    m = 0;
+    ilock(f->ip);
+    if(f->ip->type != T_DIR){
       iunlock(f->ip);
+      return -1;
+    }
+    while(m < NDENTBATCH && tot + m < n && f->off + sizeof(de) <= f->ip->size){
+      if(readi(f->ip, 0, (uint64)&de, f->off, sizeof(de)) != sizeof(de))
+        break;
+      f->off += sizeof(de);
+      if(de.inum == 0)
+        continue;
+      memset(&d[m], 0, sizeof(d[m]));
+      d[m].inum = de.inum;
+      memmove(d[m].name, de.name, DIRSIZ);
+      if(flags & GD_STAT)
+        ip[m] = dentryget(f->ip, &d[m]);
+      m++;
+    }
+    iunlock(f->ip);
+    if(m == 0)
+      break;
+
+    if(flags & GD_STAT){
+      begin_op();
+      for(i = 0; i < m; i++)
+        dentrystat(f->ip, &d[i], ip[i]);
       end_op();
+    }
+    if(copyout(myproc()->pagetable, addr + tot*sizeof(d[0]), (char*)d, m*sizeof(d[0])) < 0)
+      return -1;
+  }
+  return tot;
+}
 
-      if(r < 0)
+// poll() readiness of file f, limited to the directions
+// it was opened for.  Inodes never block.
+int
+filepoll(struct file *f)
+{
+  int r;
+
+  if(f->type == FD_PIPE)
+    return pipepoll(f->pipe, f->readable, f->writable);
+  if(f->type == FD_DEVICE && f->major >= 0 && f->major < NDEV && devsw[f->major].poll)
+    r = devsw[f->major].poll();
+  else
+    r = POLLIN|POLLOUT;
+  if(!f->readable)
+    r &= ~POLLIN;
+  if(!f->writable)
+    r &= ~POLLOUT;
+  return r;
+}
+
+// Read from file f into the user buffers described by iov,
+// in order, stopping at the first short read.  An inode is
+// locked once for the whole vector.
+int
+filereadv(struct file *f, struct iovec *iov, int iovcnt)
+{
+  int i, r, tot;
+
+  if(f->readable == 0)
+    return -1;
+
+  tot = 0;
+  if(f->type == FD_INODE){
+    ilock(f->ip);
+    for(i = 0; i < iovcnt; i++){
+      r = readi(f->ip, 1, (uint64)iov[i].iov_base, f->off, iov[i].iov_len);
+      f->off += r;
+      tot += r;
+      if(r != iov[i].iov_len)
         break;
-      if(r != n1)
-        panic("short filewrite");
-      i += r;
     }
-    ret = (i == n ? n : -1);
-  } else {
-    panic("filewrite");
+    iunlock(f->ip);
+    return tot;
   }
 
-  return ret;
+  // pipes and devices: a series of fileread()s.
+  for(i = 0; i < iovcnt; i++){
+    if((r = fileread(f, (uint64)iov[i].iov_base, iov[i].iov_len)) < 0)
+      return tot > 0 ? tot : -1;
+    tot += r;
+    if(r != iov[i].iov_len)
+      break;
+  }
+  return tot;
 }
 
+// Write the user buffers described by iov to file f, in order.
+// An inode is locked, and the log transaction held, across the
+// whole vector, splitting it only where iwritemax() demands.
+int
+filewritev(struct file *f, struct iovec *iov, int iovcnt)
+{
+  int i, r, n1, done, intrans, tot;
+
+  if(f->writable == 0)
+    return -1;
+
+  tot = 0;
+  if(f->type == FD_INODE){
+    begin_op();
+    ilock(f->ip);
+    intrans = 0;
+    for(i = 0; i < iovcnt; i++){
+      for(done = 0; done < iov[i].iov_len; done += r){
+        n1 = iov[i].iov_len - done;
+        if(n1 > iwritemax(f->ip) - intrans)
+          n1 = iwritemax(f->ip) - intrans;
+        if(n1 == 0){
+          // this transaction is full; start another.
+          iunlock(f->ip);
+          end_op();
+          begin_op();
+          ilock(f->ip);
+          intrans = 0;
+          r = 0;
+          continue;
+        }
+        if((r = writei(f->ip, 1, (uint64)iov[i].iov_base + done, f->off, n1)) > 0)
+          f->off += r;
+        if(r != n1){
+          iunlock(f->ip);
+          end_op();
+          return -1;
+        }
+        intrans += r;
+        tot += r;
+      }
+    }
+    iunlock(f->ip);
+    end_op();
+    return tot;
+  }
+
+  // pipes and devices: a series of filewrite()s.
+  // stop at a short write, so nothing is written past a gap.
+  for(i = 0; i < iovcnt; i++){
+    if((r = filewrite(f, (uint64)iov[i].iov_base, iov[i].iov_len)) < 0)
+      return tot > 0 ? tot : -1;
+    tot += r;
+    if(r != iov[i].iov_len)
+      break;
+  }
+  return tot;
+}
+
+// Move up to n bytes between an inode and a pipe, in either
+// direction, without a user-space bounce buffer: readi() and
+// writei() copy directly between the buffer cache and the
+// pipe's pages.  File to pipe blocks for pipe space like
+// write(); pipe to file returns once the pipe is empty,
+// like read().
+int
+filesplice(struct file *in, struct file *out, int n)
+{
+  char *run;
+  int m, r, tot;
+
+  if(in->readable == 0 || out->writable == 0 || n < 0)
+    return -1;
+
+  tot = 0;
+  if(in->type == FD_INODE && out->type == FD_PIPE){
+    while(tot < n){
+      if((m = pipewbegin(out->pipe, &run)) < 0)
+        return tot > 0 ? tot : -1;
+      if(m > n - tot)
+        m = n - tot;
+      ilock(in->ip);
+      if((r = readi(in->ip, 0, (uint64)run, in->off, m)) > 0)
+        in->off += r;
+      iunlock(in->ip);
+      pipewend(out->pipe, r > 0 ? r : 0);
+      if(r <= 0)
+        break;
+      tot += r;
+    }
+  } else if(in->type == FD_PIPE && out->type == FD_INODE){
+    while(tot < n){
+      if((m = piperbegin(in->pipe, &run, tot == 0)) < 0)
+        return tot > 0 ? tot : -1;
+      if(m == 0)
+        break;
+      if(m > n - tot)
+        m = n - tot;
+      begin_op();
+      ilock(out->ip);
+      // keep the transaction within the log, as in filewrite().
+      if(m > iwritemax(out->ip))
+        m = iwritemax(out->ip);
+      if((r = writei(out->ip, 0, (uint64)run, out->off, m)) > 0)
+        out->off += r;
+      iunlock(out->ip);
+      end_op();
+      piperend(in->pipe, r > 0 ? r : 0);
+      if(r != m)
+        return tot > 0 ? tot : -1;
+      tot += r;
+    }
+  } else {
+    return -1;
+  }
+  return tot;
+}
@@ -18,6 +18,7 @@ struct inode {
   uint dev;           // Device number
   uint inum;          // Inode number
   int ref;            // Reference count
+  struct inode *next; // in icache.list
   struct sleeplock lock; // protects everything below here
   int valid;          // inode has been read from disk?
 
@@ -33,8 +34,22 @@ struct inode {
 struct devsw {
   int (*read)(int, uint64, int);
   int (*write)(int, uint64, int);
+  int (*poll)(void);  // poll() readiness, or 0 if always ready
 };
 
 extern struct devsw devsw[];
 
+// file system operations on in-memory inodes, indexed by
+// device number: fs.c is the disk, tmpfs.c is in memory.
+struct fsops {
+  uint (*ialloc)(uint, short);     // allocate an inode, return its inum or 0
+  void (*iload)(struct inode*);    // fill in ip->type, ip->size, &c.
+  void (*iupdate)(struct inode*);  // write them back
+  void (*itrunc)(struct inode*);   // discard contents
+  int (*readi)(struct inode*, int, uint64, uint, uint);
+  int (*writei)(struct inode*, int, uint64, uint, uint);
+};
+
+extern struct fsops *fssw[];
+
 #define CONSOLE 1
@@ -37,6 +37,8 @@ readsb(int dev, struct superblock *sb)
   brelse(bp);
 }
 
+static void bsuminit(int);
+
 // Init fs
 void
 fsinit(int dev) {
@@ -44,6 +46,7 @@ fsinit(int dev) {
   if(sb.magic != FSMAGIC)
     panic("invalid file system");
   initlog(dev, &sb);
+  bsuminit(dev);
 }
 
 // Zero a block.
@@ -60,24 +63,97 @@ bzero(int dev, int bno)
 
 // Blocks.
 
-// Allocate a zeroed disk block.
+// In-memory summary of the free bitmap, so that balloc()
+// reads only bitmap blocks that have a free bit, and starts
+// looking where the last allocation left off (or near a
+// caller-supplied goal block) rather than at block 0.
+// nfree[] counts the blocks balloc() may hand out: it drops
+// together with a bitmap bit, while that bitmap block's
+// buffer is locked, but a freed block counts again only
+// once its transaction commits (see bcommitted()).
+#define NBMAP 64  // max bitmap blocks, so 64*BPB disk blocks
+
+struct {
+  struct spinlock lock;
+  int nbmap;           // number of bitmap blocks
+  uint nfree[NBMAP];   // allocatable blocks described by each bitmap block
+  uint hint;           // where the next unguided balloc() starts
+  uint ihint;          // where the next ialloc() starts
+  // blocks freed by the running transaction.  they stay
+  // off limits until it commits: the free isn't durable
+  // yet, and a freed metadata block may still be in the
+  // log, to be installed over whatever reuses it.
+  uchar pending[(FSSIZE+7)/8];
+} bsum;
+
+// count the free blocks in each bitmap block.
+static void
+bsuminit(int dev)
+{
+  struct buf *bp;
+  int i, bi;
+
+  initlock(&bsum.lock, "bsum");
+  bsum.nbmap = (sb.size + BPB - 1) / BPB;
+  if(bsum.nbmap > NBMAP || sb.size > FSSIZE)
+    panic("bsuminit: file system too large");
+  for(i = 0; i < bsum.nbmap; i++){
+    bp = bread(dev, sb.bmapstart + i);
+    bsum.nfree[i] = 0;
+    for(bi = 0; bi < BPB && i*BPB + bi < sb.size; bi++)
+      if((bp->data[bi/8] & (1 << (bi % 8))) == 0)
+        bsum.nfree[i]++;
+    brelse(bp);
+  }
+  bsum.hint = sb.size - sb.nblocks;  // first data block
+  bsum.ihint = 1;
+}
+
+// Allocate a disk block, as close after goal as possible;
+// a goal outside the data blocks (e.g. 0) means no preference.
+// The block is zeroed through the log if zero is set;
+// otherwise the caller must initialize it.
 static uint
-balloc(uint dev)
+balloc(uint dev, uint goal, int zero)
 {
-  int b, bi, m;
+  int i, k, bb, bi, m;
+  uint b;
   struct buf *bp;
 
-  bp = 0;
-  for(b = 0; b < sb.size; b += BPB){
-    bp = bread(dev, BBLOCK(b, sb));
-    for(bi = 0; bi < BPB && b + bi < sb.size; bi++){
+  acquire(&bsum.lock);
+  if(goal < sb.size - sb.nblocks || goal >= sb.size)
+    goal = bsum.hint;
+  release(&bsum.lock);
+
+  for(i = 0; i < bsum.nbmap; i++){
+    bb = (goal / BPB + i) % bsum.nbmap;
+    if(bsum.nfree[bb] == 0)
+      continue;
+    bp = bread(dev, sb.bmapstart + bb);
+    // search the whole bitmap block, starting at the goal.
+    for(k = 0; k < BPB; k++){
+      bi = ((i == 0 ? goal % BPB : 0) + k) % BPB;
+      if(bi % 8 == 0 && bp->data[bi/8] == 0xff){
+        k += 7;  // skip a fully allocated byte
+        continue;
+      }
+      b = bb*BPB + bi;
       m = 1 << (bi % 8);
-      if((bp->data[bi/8] & m) == 0){  // Is block free?
+      if(b < sb.size && (bp->data[bi/8] & m) == 0){  // Is block free?
+        acquire(&bsum.lock);
+        if(bsum.pending[b/8] & (1 << (b % 8))){
+          release(&bsum.lock);
+          continue;
+        }
+        bsum.nfree[bb]--;
+        bsum.hint = b + 1;
+        release(&bsum.lock);
         bp->data[bi/8] |= m;  // Mark block in use.
         log_write(bp);
         brelse(bp);
-        bzero(dev, b + bi);
-        return b + bi;
+        if(zero)
+          bzero(dev, b);
+        return b;
       }
     }
     brelse(bp);
@@ -99,9 +175,31 @@ bfree(int dev, uint b)
     panic("freeing free block");
   bp->data[bi/8] &= ~m;
   log_write(bp);
+  acquire(&bsum.lock);
+  bsum.pending[b/8] |= 1 << (b % 8);
+  release(&bsum.lock);
   brelse(bp);
 }
 
+// Called by the log once a transaction has committed:
+// the blocks it freed may now be reused.
+void
+bcommitted(void)
+{
+  int i, j;
+
+  acquire(&bsum.lock);
+  for(i = 0; i < sizeof(bsum.pending); i++){
+    if(bsum.pending[i] == 0)
+      continue;
+    for(j = 0; j < 8; j++)
+      if(bsum.pending[i] & (1 << j))
+        bsum.nfree[(i*8 + j) / BPB]++;
+    bsum.pending[i] = 0;
+  }
+  release(&bsum.lock);
+}
+
 // Inodes.
 //
 // An inode describes a single unnamed file.
@@ -127,18 +225,18 @@ bfree(int dev, uint b)
 //   is non-zero. ialloc() allocates, and iput() frees if
 //   the reference and link counts have fallen to zero.
 //
-// * Referencing in cache: an entry in the inode cache
-//   is free if ip->ref is zero. Otherwise ip->ref tracks
-//   the number of in-memory pointers to the entry (open
-//   files and current directories). iget() finds or
-//   creates a cache entry and increments its ref; iput()
-//   decrements ref.
+// * Referencing in cache: ip->ref tracks the number of
+//   in-memory pointers to a cache entry (open files and
+//   current directories). iget() finds or creates an
+//   entry and increments its ref; iput() decrements ref,
+//   and frees the entry when ref falls to zero, so the
+//   cache holds only referenced inodes.
 //
 // * Valid: the information (type, size, &c) in an inode
 //   cache entry is only correct when ip->valid is 1.
-//   ilock() reads the inode from
-//   the disk and sets ip->valid, while iput() clears
-//   ip->valid if ip->ref has fallen to zero.
+//   ilock() reads the inode from the disk and sets
+//   ip->valid; an entry iget() creates starts out invalid,
+//   so an inode nobody references is re-read from disk.
 //
 // * Locked: file system code may only examine and modify
 //   the information in an inode and its content if it
@@ -162,44 +260,69 @@ bfree(int dev, uint b)
 // have locked the inodes involved; this lets callers create
 // multi-step atomic operations.
 //
-// The icache.lock spin-lock protects the allocation of icache
-// entries. Since ip->ref indicates whether an entry is free,
-// and ip->dev and ip->inum indicate which i-node an entry
-// holds, one must hold icache.lock while using any of those fields.
+// The icache.lock spin-lock protects icache.list and the
+// allocation of icache entries. Since ip->ref decides when an
+// entry is freed, and ip->dev and ip->inum indicate which i-node
+// an entry holds, one must hold icache.lock while using any of
+// those fields.
 //
 // An ip->lock sleep-lock protects all ip-> fields other than ref,
 // dev, and inum.  One must hold ip->lock in order to
 // read or write that inode's ip->valid, ip->size, ip->type, &c.
 
+// in-memory inodes come from kmalloc() when iget() first
+// needs one and go back when their ref count drops to zero;
+// icache.list holds the ninode (at most NINODE) in use.
 struct {
   struct spinlock lock;
-  struct inode inode[NINODE];
+  struct inode *list;
+  int ninode;
 } icache;
 
+// Mounted file systems: the root of device dev appears in
+// place of directory on, which keeps a reference to on.
+// There is no unmount, so entries never change once set.
+#define NMOUNT 4
+
+struct {
+  struct spinlock lock;
+  struct {
+    struct inode *on;
+    uint dev;
+  } m[NMOUNT];
+} mtab;
+
+static struct fsops diskops;
+
 void
 iinit()
 {
-  int i = 0;
-  
   initlock(&icache.lock, "icache");
-  for(i = 0; i < NINODE; i++) {
-    initsleeplock(&icache.inode[i].lock, "inode");
-  }
+  initlock(&mtab.lock, "mtab");
+  fssw[ROOTDEV] = &diskops;
 }
 
 static struct inode* iget(uint dev, uint inum);
+static struct inode* mountroot(struct inode*);
+static struct inode* mountedon(struct inode*);
 
-// Allocate an inode on device dev.
-// Mark it as allocated by  giving it type type.
-// Returns an unlocked but allocated and referenced inode.
-struct inode*
-ialloc(uint dev, short type)
+// Allocate an inode on the disk, marking it as allocated
+// by giving it type type.  Returns its i-number.
+static uint
+diskialloc(uint dev, short type)
 {
-  int inum;
+  int i, inum;
   struct buf *bp;
   struct dinode *dip;
 
-  for(inum = 1; inum < sb.ninodes; inum++){
+  // start where the last allocation left off.
+  acquire(&bsum.lock);
+  inum = bsum.ihint;
+  release(&bsum.lock);
+
+  for(i = 1; i < sb.ninodes; i++, inum++){
+    if(inum >= sb.ninodes)
+      inum = 1;
     bp = bread(dev, IBLOCK(inum, sb));
     dip = (struct dinode*)bp->data + inum%IPB;
     if(dip->type == 0){  // a free inode
@@ -207,7 +330,10 @@ ialloc(uint dev, short type)
       dip->type = type;
       log_write(bp);   // mark it allocated on the disk
       brelse(bp);
-      return iget(dev, inum);
+      acquire(&bsum.lock);
+      bsum.ihint = inum + 1;
+      release(&bsum.lock);
+      return inum;
     }
     brelse(bp);
   }
@@ -215,11 +341,8 @@ ialloc(uint dev, short type)
 }
 
 // Copy a modified in-memory inode to disk.
-// Must be called after every change to an ip->xxx field
-// that lives on disk, since i-node cache is write-through.
-// Caller must hold ip->lock.
-void
-iupdate(struct inode *ip)
+static void
+diskiupdate(struct inode *ip)
 {
   struct buf *bp;
   struct dinode *dip;
@@ -242,31 +365,31 @@ iupdate(struct inode *ip)
 static struct inode*
 iget(uint dev, uint inum)
 {
-  struct inode *ip, *empty;
+  struct inode *ip;
 
   acquire(&icache.lock);
 
   // Is the inode already cached?
-  empty = 0;
-  for(ip = &icache.inode[0]; ip < &icache.inode[NINODE]; ip++){
-    if(ip->ref > 0 && ip->dev == dev && ip->inum == inum){
+  for(ip = icache.list; ip; ip = ip->next){
+    if(ip->dev == dev && ip->inum == inum){
       ip->ref++;
       release(&icache.lock);
       return ip;
     }
-    if(empty == 0 && ip->ref == 0)    // Remember empty slot.
-      empty = ip;
   }
 
-  // Recycle an inode cache entry.
-  if(empty == 0)
+  // Allocate a new inode cache entry.
+  if(icache.ninode >= NINODE || (ip = kmalloc(sizeof(*ip))) == 0)
     panic("iget: no inodes");
-
-  ip = empty;
+  memset(ip, 0, sizeof(*ip));
+  initsleeplock(&ip->lock, "inode");
   ip->dev = dev;
   ip->inum = inum;
   ip->ref = 1;
   ip->valid = 0;
+  ip->next = icache.list;
+  icache.list = ip;
+  icache.ninode++;
   release(&icache.lock);
 
   return ip;
@@ -283,29 +406,36 @@ idup(struct inode *ip)
   return ip;
 }
 
+// Read an inode from disk into its in-memory copy.
+static void
+diskiload(struct inode *ip)
+{
+  struct buf *bp;
+  struct dinode *dip;
+
+  bp = bread(ip->dev, IBLOCK(ip->inum, sb));
+  dip = (struct dinode*)bp->data + ip->inum%IPB;
+  ip->type = dip->type;
+  ip->major = dip->major;
+  ip->minor = dip->minor;
+  ip->nlink = dip->nlink;
+  ip->size = dip->size;
+  memmove(ip->addrs, dip->addrs, sizeof(ip->addrs));
+  brelse(bp);
+}
+
 // Lock the given inode.
 // Reads the inode from disk if necessary.
 void
 ilock(struct inode *ip)
 {
-  struct buf *bp;
-  struct dinode *dip;
-
   if(ip == 0 || ip->ref < 1)
     panic("ilock");
 
   acquiresleep(&ip->lock);
 
   if(ip->valid == 0){
-    bp = bread(ip->dev, IBLOCK(ip->inum, sb));
-    dip = (struct dinode*)bp->data + ip->inum%IPB;
-    ip->type = dip->type;
-    ip->major = dip->major;
-    ip->minor = dip->minor;
-    ip->nlink = dip->nlink;
-    ip->size = dip->size;
-    memmove(ip->addrs, dip->addrs, sizeof(ip->addrs));
-    brelse(bp);
+    fssw[ip->dev]->iload(ip);
     ip->valid = 1;
     if(ip->type == 0)
       panic("ilock: no type");
@@ -323,8 +453,8 @@ iunlock(struct inode *ip)
 }
 
 // Drop a reference to an in-memory inode.
-// If that was the last reference, the inode cache entry can
-// be recycled.
+// If that was the last reference, the inode cache entry is
+// freed.
 // If that was the last reference and the inode has no links
 // to it, free the inode (and its content) on disk.
 // All calls to iput() must be inside a transaction in
@@ -332,6 +462,8 @@ iunlock(struct inode *ip)
 void
 iput(struct inode *ip)
 {
+  struct inode **pp;
+
   acquire(&icache.lock);
 
   if(ip->ref == 1 && ip->valid && ip->nlink == 0){
@@ -353,8 +485,16 @@ iput(struct inode *ip)
     acquire(&icache.lock);
   }
 
-  ip->ref--;
+  if(--ip->ref > 0){
+    release(&icache.lock);
+    return;
+  }
+  for(pp = &icache.list; *pp != ip; pp = &(*pp)->next)
+    ;
+  *pp = ip->next;
+  icache.ninode--;
   release(&icache.lock);
+  kmfree(ip);
 }
 
 // Common idiom: unlock, then put.
@@ -374,15 +514,23 @@ iunlockput(struct inode *ip)
 
 // Return the disk block address of the nth block in inode ip.
 // If there is no such block, bmap allocates one.
+// If fresh is non-zero and bmap() has to allocate a data
+// block, the block is not zeroed and *fresh is set: the
+// caller will fill in all of it.
 static uint
-bmap(struct inode *ip, uint bn)
+bmap(struct inode *ip, uint bn, int *fresh)
 {
   uint addr, *a;
   struct buf *bp;
 
+  // new blocks go right after the file's previous block,
+  // when there is one, to keep files contiguous.
   if(bn < NDIRECT){
-    if((addr = ip->addrs[bn]) == 0)
-      ip->addrs[bn] = addr = balloc(ip->dev);
+    if((addr = ip->addrs[bn]) == 0){
+      ip->addrs[bn] = addr = balloc(ip->dev, bn > 0 ? ip->addrs[bn-1] + 1 : 0, fresh == 0);
+      if(fresh)
+        *fresh = 1;
+    }
     return addr;
   }
   bn -= NDIRECT;
@@ -390,11 +538,13 @@ bmap(struct inode *ip, uint bn)
   if(bn < NINDIRECT){
     // Load indirect block, allocating if necessary.
     if((addr = ip->addrs[NDIRECT]) == 0)
-      ip->addrs[NDIRECT] = addr = balloc(ip->dev);
+      ip->addrs[NDIRECT] = addr = balloc(ip->dev, ip->addrs[NDIRECT-1] + 1, 1);
     bp = bread(ip->dev, addr);
     a = (uint*)bp->data;
     if((addr = a[bn]) == 0){
-      a[bn] = addr = balloc(ip->dev);
+      a[bn] = addr = balloc(ip->dev, bn > 0 ? a[bn-1] + 1 : ip->addrs[NDIRECT] + 1, fresh == 0);
+      if(fresh)
+        *fresh = 1;
       log_write(bp);
     }
     brelse(bp);
@@ -405,9 +555,8 @@ bmap(struct inode *ip, uint bn)
 }
 
 // Truncate inode (discard contents).
-// Caller must hold ip->lock.
-void
-itrunc(struct inode *ip)
+static void
+diskitrunc(struct inode *ip)
 {
   int i, j;
   struct buf *bp;
@@ -449,11 +598,8 @@ stati(struct inode *ip, struct stat *st)
 }
 
 // Read data from inode.
-// Caller must hold ip->lock.
-// If user_dst==1, then dst is a user virtual address;
-// otherwise, dst is a kernel address.
-int
-readi(struct inode *ip, int user_dst, uint64 dst, uint off, uint n)
+static int
+diskreadi(struct inode *ip, int user_dst, uint64 dst, uint off, uint n)
 {
   uint tot, m;
   struct buf *bp;
@@ -464,7 +610,7 @@ readi(struct inode *ip, int user_dst, uint64 dst, uint off, uint n)
     n = ip->size - off;
 
   for(tot=0; tot<n; tot+=m, off+=m, dst+=m){
-    bp = bread(ip->dev, bmap(ip, off/BSIZE));
+    bp = bread(ip->dev, bmap(ip, off/BSIZE, 0));
     m = min(n - tot, BSIZE - off%BSIZE);
     if(either_copyout(user_dst, dst, bp->data + (off % BSIZE), m) == -1) {
       brelse(bp);
@@ -475,29 +621,74 @@ readi(struct inode *ip, int user_dst, uint64 dst, uint off, uint n)
   return tot;
 }
 
-// Write data to inode.
-// Caller must hold ip->lock.
-// If user_src==1, then src is a user virtual address;
-// otherwise, src is a kernel address.
+// Ordered data: the contents of regular files bypass the
+// log.  writei() writes file data blocks straight to their
+// home locations, before the transaction that points the
+// inode at them commits, so only metadata (inodes, bitmap,
+// indirect blocks, directories) is journaled.
+
+// The most bytes a single writei() to ip may write inside
+// one transaction.  File data doesn't use log space, so a
+// write of any size logs just the inode, the indirect block
+// and the bitmap; other writes are limited by the log,
+// counting i-node, indirect block, allocation blocks,
+// and 2 blocks of slop for non-aligned writes.
 int
-writei(struct inode *ip, int user_src, uint64 src, uint off, uint n)
+iwritemax(struct inode *ip)
 {
-  uint tot, m;
+  if(fssw[ip->dev] != &diskops)
+    return MAXFILE*BSIZE;  // not logged at all
+  if(ip->type == T_FILE && 1 + 1 + bsum.nbmap <= MAXOPBLOCKS)
+    return MAXFILE*BSIZE;
+  return ((MAXOPBLOCKS-1-1-2) / 2) * BSIZE;
+}
+
+// Write data to inode.
+static int
+diskwritei(struct inode *ip, int user_src, uint64 src, uint off, uint n)
+{
+  uint tot, m, addr;
   struct buf *bp;
+  int ordered, fresh;
 
   if(off > ip->size || off + n < off)
     return -1;
   if(off + n > MAXFILE*BSIZE)
     return -1;
 
+  ordered = (ip->type == T_FILE);
   for(tot=0; tot<n; tot+=m, off+=m, src+=m){
-    bp = bread(ip->dev, bmap(ip, off/BSIZE));
     m = min(n - tot, BSIZE - off%BSIZE);
+    if(!ordered){
+      bp = bread(ip->dev, bmap(ip, off/BSIZE, 0));
+      if(either_copyin(bp->data + (off % BSIZE), user_src, src, m) == -1) {
+        brelse(bp);
+        break;
+      }
+      log_write(bp);
+      brelse(bp);
+      continue;
+    }
+
+    // don't read a block that is new or about to be
+    // overwritten completely.
+    fresh = 0;
+    addr = bmap(ip, off/BSIZE, &fresh);
+    if(fresh || m == BSIZE)
+      bp = bblank(ip->dev, addr);
+    else
+      bp = bread(ip->dev, addr);
+    if(fresh)
+      memset(bp->data, 0, BSIZE);
     if(either_copyin(bp->data + (off % BSIZE), user_src, src, m) == -1) {
+      if(fresh)
+        bwrite(bp);  // don't leave the block's old contents on disk
+      else if(m == BSIZE)
+        bp->valid = 0;  // cached data may match neither old nor new
       brelse(bp);
       break;
     }
-    log_write(bp);
+    bwrite(bp);
     brelse(bp);
   }
 
@@ -513,6 +704,74 @@ writei(struct inode *ip, int user_src, uint64 src, uint off, uint n)
   return n;
 }
 
+// File system switch.  The generic inode layer above
+// (icache, ilock(), iput()) and below (directories, path
+// names) serves every file system; these calls go to the
+// one that owns the inode's device.
+
+static struct fsops diskops = {
+  diskialloc,
+  diskiload,
+  diskiupdate,
+  diskitrunc,
+  diskreadi,
+  diskwritei,
+};
+
+struct fsops *fssw[NDEV];
+
+// Allocate an inode on device dev.
+// Mark it as allocated by  giving it type type.
+// Returns an unlocked but allocated and referenced inode,
+// or 0 if the file system is out of inodes.
+struct inode*
+ialloc(uint dev, short type)
+{
+  uint inum;
+
+  if((inum = fssw[dev]->ialloc(dev, type)) == 0)
+    return 0;
+  return iget(dev, inum);
+}
+
+// Copy a modified in-memory inode to its file system.
+// Must be called after every change to an ip->xxx field
+// that lives on disk, since i-node cache is write-through.
+// Caller must hold ip->lock.
+void
+iupdate(struct inode *ip)
+{
+  fssw[ip->dev]->iupdate(ip);
+}
+
+// Truncate inode (discard contents).
+// Caller must hold ip->lock.
+void
+itrunc(struct inode *ip)
+{
+  fssw[ip->dev]->itrunc(ip);
+}
+
+// Read data from inode.
+// Caller must hold ip->lock.
+// If user_dst==1, then dst is a user virtual address;
+// otherwise, dst is a kernel address.
+int
+readi(struct inode *ip, int user_dst, uint64 dst, uint off, uint n)
+{
+  return fssw[ip->dev]->readi(ip, user_dst, dst, off, n);
+}
+
+// Write data to inode.
+// Caller must hold ip->lock.
+// If user_src==1, then src is a user virtual address;
+// otherwise, src is a kernel address.
+int
+writei(struct inode *ip, int user_src, uint64 src, uint off, uint n)
+{
+  return fssw[ip->dev]->writei(ip, user_src, src, off, n);
+}
+
 // Directories
 
 int
@@ -549,6 +808,44 @@ dirlookup(struct inode *dp, char *name, uint *poff)
   return 0;
 }
 
+// Return a reference to the inode that directory entry d
+// of dp names, for dentrystat().  Caller holds dp->lock,
+// so the entry, and therefore its inode, still exist.
+struct inode*
+dentryget(struct inode *dp, struct dentry *d)
+{
+  return iget(dp->dev, d->inum);
+}
+
+// Fill in the inum, type and size of directory entry d
+// of dp from ip, the entry's inode, crossing mount points
+// the way namex() does.  The caller took the reference to
+// ip while holding dp->lock, so that an unlink since then
+// can't have freed the inode; dentrystat() drops it.
+// Caller must not hold dp->lock.
+// Must be called inside a transaction since it calls iput().
+void
+dentrystat(struct inode *dp, struct dentry *d, struct inode *ip)
+{
+  struct inode *up, *pp;
+
+  if(namecmp(d->name, "..") == 0 && (up = mountedon(dp)) != 0){
+    ilock(up);
+    pp = dirlookup(up, "..", 0);
+    iunlockput(up);
+    if(pp){
+      iput(ip);
+      ip = pp;
+    }
+  }
+  ip = mountroot(ip);
+  ilock(ip);
+  d->inum = ip->inum;
+  d->type = ip->type;
+  d->size = ip->size;
+  iunlockput(ip);
+}
+
 // Write a new directory entry (name, inum) into the directory dp.
 int
 dirlink(struct inode *dp, char *name, uint inum)
@@ -618,6 +915,93 @@ skipelem(char *path, char *name)
   return path;
 }
 
+// Mount the root of device dev over directory ip,
+// which must not already be a mount point.
+// Takes over the caller's reference to ip.
+int
+mount(struct inode *ip, uint dev)
+{
+  int i, slot;
+
+  if(dev >= NDEV || fssw[dev] == 0)
+    return -1;
+  acquire(&mtab.lock);
+  slot = -1;
+  for(i = 0; i < NMOUNT; i++){
+    if(mtab.m[i].on == 0){
+      if(slot < 0)
+        slot = i;
+    } else if(mtab.m[i].on == ip || mtab.m[i].dev == dev){
+      slot = -1;
+      break;
+    }
+  }
+  if(slot < 0){
+    release(&mtab.lock);
+    return -1;
+  }
+  mtab.m[slot].dev = dev;
+  mtab.m[slot].on = ip;
+  release(&mtab.lock);
+  return 0;
+}
+
+// Is a file system mounted on ip?
+int
+ismountpoint(struct inode *ip)
+{
+  int i;
+
+  acquire(&mtab.lock);
+  for(i = 0; i < NMOUNT; i++){
+    if(mtab.m[i].on == ip){
+      release(&mtab.lock);
+      return 1;
+    }
+  }
+  release(&mtab.lock);
+  return 0;
+}
+
+// If a file system is mounted on ip, swap the reference
+// to ip for one to the mounted root.
+static struct inode*
+mountroot(struct inode *ip)
+{
+  int i;
+
+  acquire(&mtab.lock);
+  for(i = 0; i < NMOUNT; i++){
+    if(mtab.m[i].on == ip){
+      release(&mtab.lock);
+      iput(ip);
+      return iget(mtab.m[i].dev, ROOTINO);
+    }
+  }
+  release(&mtab.lock);
+  return ip;
+}
+
+// If ip is the root of a mounted file system,
+// return a new reference to the directory it is mounted on.
+static struct inode*
+mountedon(struct inode *ip)
+{
+  int i;
+
+  if(ip->inum != ROOTINO)
+    return 0;
+  acquire(&mtab.lock);
+  for(i = 0; i < NMOUNT; i++){
+    if(mtab.m[i].on && mtab.m[i].dev == ip->dev){
+      release(&mtab.lock);
+      return idup(mtab.m[i].on);
+    }
+  }
+  release(&mtab.lock);
+  return 0;
+}
+
 // Look up and return the inode for a path name.
 // If parent != 0, return the inode for the parent and copy the final
 // path element into name, which must have room for DIRSIZ bytes.
@@ -643,12 +1027,19 @@ namex(char *path, int nameiparent, char *name)
       iunlock(ip);
       return ip;
     }
+    if(namecmp(name, "..") == 0 && (next = mountedon(ip)) != 0){
+      // ".." from the root of a mounted file system is
+      // ".." of the directory it is mounted on.
+      iunlockput(ip);
+      ip = next;
+      ilock(ip);
+    }
     if((next = dirlookup(ip, name, 0)) == 0){
       iunlockput(ip);
       return 0;
     }
     iunlockput(ip);
-    ip = next;
+    ip = mountroot(next);
   }
   if(nameiparent){
     iput(ip);
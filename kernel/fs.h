@@ -58,3 +58,13 @@ struct dirent {
   char name[DIRSIZ];
 };
 
+// getdents() fills in an array of these, one per used
+// directory entry.  type and size are 0 unless GD_STAT
+// is passed; then inum, type and size are what stat()
+// of the entry would say, following mount points.
+struct dentry {
+  uint inum;
+  short type;
+  uint64 size;
+  char name[DIRSIZ+1];  // null-terminated
+};
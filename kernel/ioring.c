@@ -0,0 +1,128 @@
+//
+// Batched system calls through a submission/completion
+// ring shared with the process (see ioring.h).
+//
+// The ring lives in a kalloc'd page mapped at USERRING in
+// the process's page table; the kernel reads and writes it
+// through its own direct mapping.  Everything in it is
+// under the process's control, so indices are masked and
+// each drain is bounded.  Entries run one at a time, in
+// order, with the same code as the system calls they name.
+//
+
+#include "types.h"
+#include "riscv.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "fs.h"
+#include "sleeplock.h"
+#include "file.h"
+#include "ioring.h"
+
+static int
+ringfd(struct proc *p, int fd, struct file **pf)
+{
+  if(fd < 0 || fd >= NOFILE || (*pf = p->ofile[fd]) == 0)
+    return -1;
+  return 0;
+}
+
+// carry out one submission; returns its result.
+static int
+ringop(struct proc *p, struct sqe *e)
+{
+  char path[MAXPATH];
+  struct file *f;
+
+  switch(e->op){
+  case RING_NOP:
+    return 0;
+  case RING_READ:
+    if(ringfd(p, e->fd, &f) < 0)
+      return -1;
+    return fileread(f, e->addr, e->n);
+  case RING_WRITE:
+    if(ringfd(p, e->fd, &f) < 0)
+      return -1;
+    return filewrite(f, e->addr, e->n);
+  case RING_OPEN:
+    if(copyinstr(p->pagetable, path, e->addr, MAXPATH) < 0)
+      return -1;
+    return fileopen(path, e->n);
+  case RING_CLOSE:
+    if(ringfd(p, e->fd, &f) < 0)
+      return -1;
+    p->ofile[e->fd] = 0;
+    fileclose(f);
+    return 0;
+  case RING_FSTAT:
+    if(ringfd(p, e->fd, &f) < 0)
+      return -1;
+    return filestat(f, e->addr);
+  }
+  return -1;
+}
+
+// run the current process's queued submissions, stopping
+// when the completion ring is full.  returns the number run.
+int
+ringdrain(void)
+{
+  struct proc *p = myproc();
+  struct ioring *r = p->ring;
+  struct sqe e;
+  struct cqe *c;
+  int n;
+
+  if(r == 0)
+    return -1;
+  for(n = 0; n < RINGSIZE; n++){
+    __sync_synchronize();
+    if(r->sqhead == r->sqtail || r->cqtail - r->cqhead >= RINGSIZE)
+      break;
+    // copy the entry so the process can't change it under us.
+    e = r->sq[r->sqhead % RINGSIZE];
+    r->sqhead++;
+    c = &r->cq[r->cqtail % RINGSIZE];
+    c->res = ringop(p, &e);
+    c->tag = e.tag;
+    // publish the completion before the tail that covers it.
+    __sync_synchronize();
+    r->cqtail++;
+  }
+  return n;
+}
+
+// give the current process a ring, mapped at USERRING.
+// returns its user address.
+uint64
+ringsetup(int flags)
+{
+  struct proc *p = myproc();
+  char *mem;
+
+  if(p->ring)
+    return -1;
+  if((mem = kalloc()) == 0)
+    return -1;
+  memset(mem, 0, PGSIZE);
+  if(mappages(p->pagetable, USERRING, PGSIZE, (uint64)mem, PTE_R|PTE_W|PTE_U) < 0){
+    kfree(mem);
+    return -1;
+  }
+  uvmflushpage(p, USERRING);
+  p->ring = (struct ioring*)mem;
+  p->ringpoll = (flags & RING_POLL) != 0;
+  return USERRING;
+}
+
+// unmap and free pagetable's ring, if it has one.
+void
+ringfree(pagetable_t pagetable)
+{
+  if(walkaddr(pagetable, USERRING))
+    uvmunmap(pagetable, USERRING, 1, 1);
+}
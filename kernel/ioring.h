@@ -0,0 +1,50 @@
+// Submission/completion rings for batched I/O, set up by
+// ringsetup() in a page shared by the process and the kernel.
+// Both the kernel and user programs use this header file.
+//
+// The process fills in sq[sqtail % RINGSIZE] and then
+// advances sqtail; the kernel consumes entries at sqhead.
+// The kernel posts results at cq[cqtail % RINGSIZE] and
+// advances cqtail; the process consumes them at cqhead.
+// The indices only ever increase.
+
+#define RINGSIZE 32  // entries per ring; a power of two
+
+// ringsetup() flags
+#define RING_POLL 1  // drain the ring on every entry to the kernel
+
+// with RING_POLL, a process that makes no system calls enters
+// the kernel only when its quantum ends, so its entries may
+// wait up to QUANTUM timer cycles to run.
+
+// operations
+#define RING_NOP   0
+#define RING_READ  1  // read(fd, addr, n)
+#define RING_WRITE 2  // write(fd, addr, n)
+#define RING_OPEN  3  // open(addr, n), returns the fd
+#define RING_CLOSE 4  // close(fd)
+#define RING_FSTAT 5  // fstat(fd, addr)
+
+struct sqe {
+  int op;        // RING_*
+  int fd;
+  uint64 addr;   // user buffer, path or struct stat
+  int n;         // byte count, or open mode
+  int pad;
+  uint64 tag;    // copied to the completion
+};
+
+struct cqe {
+  uint64 tag;    // from the submission
+  int res;       // what the system call would have returned
+  int pad;
+};
+
+struct ioring {
+  uint sqhead;   // written by the kernel
+  uint sqtail;   // written by the process
+  uint cqhead;   // written by the process
+  uint cqtail;   // written by the kernel
+  struct sqe sq[RINGSIZE];
+  struct cqe cq[RINGSIZE];
+};
@@ -1,6 +1,13 @@
 // Physical memory allocator, for user processes,
-// kernel stacks, page-table pages,
-// and pipe buffers. Allocates whole 4096-byte pages.
+// kernel stacks, page-table pages, pipe buffers,
+// and slab.c's small-object slabs.
+//
+// A buddy allocator: memory is handed out in blocks of
+// 2^order pages, each aligned (from KERNBASE) to its own
+// size.  A free block of order k and its buddy (the other
+// half of the order k+1 block containing both) are merged
+// as soon as both are free.  kalloc() and kfree() deal in
+// single pages; kallocorder() and kfreeorder() in blocks.
 
 #include "types.h"
 #include "param.h"
@@ -14,20 +21,30 @@ void freerange(void *pa_start, void *pa_end);
 extern char end[]; // first address after kernel.
                    // defined by kernel.ld.
 
+#define NPAGE ((PHYSTOP - KERNBASE) / PGSIZE)
+#define PGINDEX(pa) (((uint64)(pa) - KERNBASE) / PGSIZE)
+#define PGFREE 0x80   // in pgstate[]: first page of a free block
+
 struct run {
   struct run *next;
+  struct run *prev;
 };
 
 struct {
   struct spinlock lock;
-  struct run *freelist;
+  struct run *free[MAXORDER+1];  // free blocks of each order
+  uchar pgstate[NPAGE];          // PGFREE|order, or 0
+  uint64 start, end;             // memory kfree() may be given
 } kmem;
 
 void
 kinit()
 {
   initlock(&kmem.lock, "kmem");
-  freerange(end, (void*)PHYSTOP);
+  kmem.start = PGROUNDUP((uint64)end);
+  // the RAM disk image, if any, occupies the top of memory.
+  kmem.end = ramdisk ? (uint64)ramdisk : PHYSTOP;
+  freerange((void*)kmem.start, (void*)kmem.end);
 }
 
 void
@@ -39,44 +56,125 @@ freerange(void *pa_start, void *pa_end)
     kfree(p);
 }
 
-// Free the page of physical memory pointed at by v,
-// which normally should have been returned by a
-// call to kalloc().  (The exception is when
-// initializing the allocator; see kinit above.)
+static void
+pushfree(struct run *r, int order)
+{
+  r->prev = 0;
+  r->next = kmem.free[order];
+  if(r->next)
+    r->next->prev = r;
+  kmem.free[order] = r;
+  kmem.pgstate[PGINDEX(r)] = PGFREE | order;
+}
+
+static void
+unlinkfree(struct run *r, int order)
+{
+  if(r->prev)
+    r->prev->next = r->next;
+  else
+    kmem.free[order] = r->next;
+  if(r->next)
+    r->next->prev = r->prev;
+  kmem.pgstate[PGINDEX(r)] = 0;
+}
+
+// Free the block of 2^order pages at pa, which normally
+// should have been returned by kallocorder(order).
+// (The exception is when initializing the allocator;
+// see kinit above.)
 void
-kfree(void *pa)
+kfreeorder(void *pa, int order)
 {
-  struct run *r;
+  uint64 a, buddy, size;
 
-  if(((uint64)pa % PGSIZE) != 0 || (char*)pa < end || (uint64)pa >= PHYSTOP)
+  size = (uint64)PGSIZE << order;
+  a = (uint64)pa;
+  if(order < 0 || order > MAXORDER || ((a - KERNBASE) & (size - 1)) != 0 ||
+     a < kmem.start || a + size > kmem.end)
     panic("kfree");
 
   // Fill with junk to catch dangling refs.
-  memset(pa, 1, PGSIZE);
-
-  r = (struct run*)pa;
+  memset(pa, 1, size);
 
   acquire(&kmem.lock);
-  r->next = kmem.freelist;
-  kmem.freelist = r;
+  for(; order < MAXORDER; order++){
+    size = (uint64)PGSIZE << order;
+    buddy = KERNBASE + ((a - KERNBASE) ^ size);
+    if(buddy < kmem.start || buddy + size > kmem.end)
+      break;
+    if(kmem.pgstate[PGINDEX(buddy)] != (PGFREE | order))
+      break;
+    unlinkfree((struct run*)buddy, order);
+    if(buddy < a)
+      a = buddy;
+  }
+  pushfree((struct run*)a, order);
   release(&kmem.lock);
 }
 
-// Allocate one 4096-byte page of physical memory.
-// Returns a pointer that the kernel can use.
-// Returns 0 if the memory cannot be allocated.
+// Free the page of physical memory pointed at by pa.
+void
+kfree(void *pa)
+{
+  kfreeorder(pa, 0);
+}
+
+// take a block of 2^order pages off the free lists,
+// splitting a larger block if need be.
+// caller holds kmem.lock.
+static struct run*
+takefree(int order)
+{
+  struct run *r;
+  int k;
+
+  for(k = order; k <= MAXORDER && kmem.free[k] == 0; k++)
+    ;
+  if(k > MAXORDER)
+    return 0;
+  r = kmem.free[k];
+  unlinkfree(r, k);
+  // give back the upper half until r is the right size.
+  while(k > order){
+    k--;
+    pushfree((struct run*)((char*)r + ((uint64)PGSIZE << k)), k);
+  }
+  return r;
+}
+
+// Allocate 2^order physically contiguous pages, aligned
+// to their total size.  Returns a pointer that the kernel
+// can use, or 0 if the memory cannot be allocated.
 void *
-kalloc(void)
+kallocorder(int order)
 {
   struct run *r;
 
+  if(order < 0 || order > MAXORDER)
+    return 0;
+
   acquire(&kmem.lock);
-  r = kmem.freelist;
-  if(r)
-    kmem.freelist = r->next;
+  r = takefree(order);
   release(&kmem.lock);
 
+  // out of pages: take back the slab allocator's spares.
+  if(r == 0 && slabreclaim() > 0){
+    acquire(&kmem.lock);
+    r = takefree(order);
+    release(&kmem.lock);
+  }
+
   if(r)
-    memset((char*)r, 5, PGSIZE); // fill with junk
+    memset((char*)r, 5, (uint64)PGSIZE << order); // fill with junk
   return (void*)r;
 }
+
+// Allocate one 4096-byte page of physical memory.
+// Returns a pointer that the kernel can use.
+// Returns 0 if the memory cannot be allocated.
+void *
+kalloc(void)
+{
+  return kallocorder(0);
+}
@@ -6,6 +6,7 @@
 #include "sleeplock.h"
 #include "fs.h"
 #include "buf.h"
+#include "trace.h"
 
 // Simple logging that allows concurrent FS system calls.
 //
@@ -29,6 +30,11 @@
 //   block C
 //   ...
 // Log appends are synchronous.
+//
+// Only metadata goes through the log.  The contents of regular
+// files are written in place by writei() before the transaction
+// that refers to them commits (ordered data); blocks freed by a
+// transaction aren't reused until it commits (see bcommitted()).
 
 // Contents of the header block, used for both the on-disk header block
 // and to keep track in memory of logged block# before commit.
@@ -134,6 +140,7 @@ begin_op(void)
       sleep(&log, &log.lock);
     } else {
       log.outstanding += 1;
+      ktrace(TR_BEGINOP, log.outstanding, 0);
       release(&log.lock);
       break;
     }
@@ -160,12 +167,14 @@ end_op(void)
     // the amount of reserved space.
     wakeup(&log);
   }
+  ktrace(TR_ENDOP, do_commit, 0);
   release(&log.lock);
 
   if(do_commit){
     // call commit w/o holding locks, since not allowed
     // to sleep with locks.
     commit();
+    bcommitted();
     acquire(&log.lock);
     log.committing = 0;
     wakeup(&log);
@@ -196,6 +205,7 @@ commit()
     write_log();     // Write modified blocks from cache to log
     write_head();    // Write header to disk -- the real commit
     install_trans(); // Now install writes to home locations
+    ktrace(TR_COMMIT, log.lh.n, 0);
     log.lh.n = 0;
     write_head();    // Erase the transaction from the log
   }
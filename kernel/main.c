@@ -13,12 +13,16 @@ main()
   if(cpuid() == 0){
     consoleinit();
     printfinit();
+    traceinit();
     printf("\n");
     printf("xv6 kernel is booting\n");
     printf("\n");
+    ramdiskinit();   // fs.img loaded into memory?
     kinit();         // physical page allocator
+    slabinit();      // small-object allocator
     kvminit();       // create kernel page table
     kvminithart();   // turn on paging
+    asidinit();      // address-space IDs
     procinit();      // process table
     trapinit();      // trap vectors
     trapinithart();  // install kernel trap vector
@@ -26,8 +30,10 @@ main()
     plicinithart();  // ask PLIC for device interrupts
     binit();         // buffer cache
     iinit();         // inode cache
+    tmpfsinit();     // in-memory file system
     fileinit();      // file table
-    virtio_disk_init(); // emulated hard disk
+    if(!ramdisk)
+      virtio_disk_init(); // emulated hard disk
     userinit();      // first user process
     __sync_synchronize();
     started = 1;
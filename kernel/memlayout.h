@@ -27,8 +27,10 @@
 
 // local interrupt controller, which contains the timer.
 #define CLINT 0x2000000L
+#define CLINT_MSIP(hartid) (CLINT + 4*(hartid)) // software interrupt, for IPIs.
 #define CLINT_MTIMECMP(hartid) (CLINT + 0x4000 + 8*(hartid))
 #define CLINT_MTIME (CLINT + 0xBFF8) // cycles since boot.
+#define CLINT_FREQ 10000000L         // MTIME cycles per second in qemu.
 
 // qemu puts programmable interrupt controller here.
 #define PLIC 0x0c000000L
@@ -60,8 +62,18 @@
 //   text
 //   original data and bss
 //   fixed-size stack
-//   expandable heap
+//   expandable heap, up to MAXUVA
 //   ...
+//   CLOCKPAGE (struct clockpage, read-only)
+//   USERRING (p->ring, if the process called ringsetup())
 //   TRAPFRAME (p->trapframe, used by the trampoline)
 //   TRAMPOLINE (the same page as in the kernel)
 #define TRAPFRAME (TRAMPOLINE - PGSIZE)
+#define USERRING (TRAPFRAME - PGSIZE)
+#define CLOCKPAGE (USERRING - PGSIZE)
+
+// each process's kernel page table maps its memory
+// at the same addresses, so it must end below the
+// lowest device the kernel uses (the CLINT is left
+// out; only machine mode touches it).
+#define MAXUVA PLIC
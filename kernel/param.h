@@ -5,9 +5,13 @@
 #define NINODE       50  // maximum number of active i-nodes
 #define NDEV         10  // maximum major device number
 #define ROOTDEV       1  // device number of file system root disk
+#define TMPDEV        2  // device number of the in-memory tmpfs
 #define MAXARG       32  // max exec arguments
 #define MAXOPBLOCKS  10  // max # of blocks any FS op writes
 #define LOGSIZE      (MAXOPBLOCKS*3)  // max data blocks in on-disk log
 #define NBUF         (MAXOPBLOCKS*3)  // size of disk block cache
-#define FSSIZE       1000  // size of file system in blocks
+#define MAXORDER     10  // largest kallocorder() block, 2^10 pages
+#define FSSIZE       2000  // size of file system in blocks
 #define MAXPATH      128   // maximum file path name
+#define TICKCYCLES   1000000  // timer cycles per clock tick; about 1/10th second in qemu
+#define QUANTUM      1000000  // timer cycles a process runs before it must yield
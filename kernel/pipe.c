@@ -7,18 +7,42 @@
 #include "fs.h"
 #include "sleeplock.h"
 #include "file.h"
+#include "poll.h"
 
-#define PIPESIZE 512
+// pipe data lives in whole pages, separate from struct pipe,
+// so a pipe can hold up to PIPEMAXPAGES pages and be resized
+// with fcntl(F_SETPIPE_SZ).  the capacity is always a power
+// of two, so nread and nwrite can wrap freely.
+#define PIPEMAXPAGES 16
 
 struct pipe {
   struct spinlock lock;
-  char data[PIPESIZE];
+  char *pages[PIPEMAXPAGES];
+  uint size;      // capacity in bytes, PGSIZE << k
   uint nread;     // number of bytes read
   uint nwrite;    // number of bytes written
   int readopen;   // read fd is still open
   int writeopen;  // write fd is still open
+  int rbusy;      // a splice is copying out of the buffer
+  int wbusy;      // a splice is copying into the buffer
 };
 
+// kalloc npages data pages into pg[]; all or nothing.
+static int
+pipepages(char **pg, int npages)
+{
+  int i;
+
+  for(i = 0; i < npages; i++){
+    if((pg[i] = kalloc()) == 0){
+      while(--i >= 0)
+        kfree(pg[i]);
+      return -1;
+    }
+  }
+  return 0;
+}
+
 int
 pipealloc(struct file **f0, struct file **f1)
 {
@@ -28,12 +52,20 @@ pipealloc(struct file **f0, struct file **f1)
   *f0 = *f1 = 0;
   if((*f0 = filealloc()) == 0 || (*f1 = filealloc()) == 0)
     goto bad;
-  if((pi = (struct pipe*)kalloc()) == 0)
+  if((pi = (struct pipe*)kmalloc(sizeof(*pi))) == 0)
     goto bad;
+  if(pipepages(pi->pages, 1) < 0){
+    kmfree(pi);
+    pi = 0;
+    goto bad;
+  }
+  pi->size = PGSIZE;
   pi->readopen = 1;
   pi->writeopen = 1;
   pi->nwrite = 0;
   pi->nread = 0;
+  pi->rbusy = 0;
+  pi->wbusy = 0;
   initlock(&pi->lock, "pipe");
   (*f0)->type = FD_PIPE;
   (*f0)->readable = 1;
@@ -47,7 +79,7 @@ pipealloc(struct file **f0, struct file **f1)
 
  bad:
   if(pi)
-    kfree((char*)pi);
+    kmfree(pi);
   if(*f0)
     fileclose(*f0);
   if(*f1)
@@ -58,6 +90,8 @@ pipealloc(struct file **f0, struct file **f1)
 void
 pipeclose(struct pipe *pi, int writable)
 {
+  int i;
+
   acquire(&pi->lock);
   if(writable){
     pi->writeopen = 0;
@@ -68,21 +102,61 @@ pipeclose(struct pipe *pi, int writable)
   }
   if(pi->readopen == 0 && pi->writeopen == 0){
     release(&pi->lock);
-    kfree((char*)pi);
+    for(i = 0; i < pi->size / PGSIZE; i++)
+      kfree(pi->pages[i]);
+    kmfree(pi);
   } else
     release(&pi->lock);
 }
 
+// poll() readiness of the read and/or write end, after
+// registering the channels that a change would wake.
+int
+pipepoll(struct pipe *pi, int readable, int writable)
+{
+  int r = 0;
+
+  acquire(&pi->lock);
+  if(readable){
+    pollwait(&pi->nread);
+    if(pi->nread != pi->nwrite)
+      r |= POLLIN;
+    if(pi->writeopen == 0)
+      r |= POLLIN|POLLHUP;
+  }
+  if(writable){
+    pollwait(&pi->nwrite);
+    if(pi->readopen == 0)
+      r |= POLLERR;
+    else if(pi->nwrite - pi->nread < pi->size)
+      r |= POLLOUT;
+  }
+  release(&pi->lock);
+  return r;
+}
+
+// address and length of the longest run of pipe
+// buffer starting at byte offset off that doesn't
+// cross a page boundary.
+static char*
+piperun(struct pipe *pi, uint off, int *len)
+{
+  off %= pi->size;
+  *len = PGSIZE - off % PGSIZE;
+  return pi->pages[off / PGSIZE] + off % PGSIZE;
+}
+
 int
 pipewrite(struct pipe *pi, uint64 addr, int n)
 {
-  int i;
-  char ch;
+  int i, m, len;
+  char *dst;
   struct proc *pr = myproc();
 
   acquire(&pi->lock);
-  for(i = 0; i < n; i++){
-    while(pi->nwrite == pi->nread + PIPESIZE){  //DOC: pipewrite-full
+  i = 0;
+  while(i < n){
+    while(pi->wbusy || pi->nwrite - pi->nread == pi->size){  //DOC: pipewrite-full
       if(pi->readopen == 0 || pr->killed){
         release(&pi->lock);
         return -1;
@@ -90,9 +164,17 @@ pipewrite(struct pipe *pi, uint64 addr, int n)
       wakeup(&pi->nread);
       sleep(&pi->nwrite, &pi->lock);
     }
-    if(copyin(pr->pagetable, &ch, addr + i, 1) == -1)
+    // copy as much as fits in free space before the page ends.
+    dst = piperun(pi, pi->nwrite, &len);
+    m = n - i;
+    if(m > len)
+      m = len;
+    if(m > pi->size - (pi->nwrite - pi->nread))
+      m = pi->size - (pi->nwrite - pi->nread);
+    if(copyin(pr->pagetable, dst, addr + i, m) == -1)
       break;
-    pi->data[pi->nwrite++ % PIPESIZE] = ch;
+    pi->nwrite += m;
+    i += m;
   }
   wakeup(&pi->nread);
   release(&pi->lock);
@@ -102,26 +184,192 @@ pipewrite(struct pipe *pi, uint64 addr, int n)
 int
 piperead(struct pipe *pi, uint64 addr, int n)
 {
-  int i;
+  int i, m, len;
+  char *src;
   struct proc *pr = myproc();
-  char ch;
 
   acquire(&pi->lock);
-  while(pi->nread == pi->nwrite && pi->writeopen){  //DOC: pipe-empty
+  while(pi->rbusy || (pi->nread == pi->nwrite && pi->writeopen)){  //DOC: pipe-empty
     if(pr->killed){
       release(&pi->lock);
       return -1;
     }
     sleep(&pi->nread, &pi->lock); //DOC: piperead-sleep
   }
-  for(i = 0; i < n; i++){  //DOC: piperead-copy
-    if(pi->nread == pi->nwrite)
-      break;
-    ch = pi->data[pi->nread++ % PIPESIZE];
-    if(copyout(pr->pagetable, addr + i, &ch, 1) == -1)
+  i = 0;
+  while(i < n && pi->nread != pi->nwrite){  //DOC: piperead-copy
+    src = piperun(pi, pi->nread, &len);
+    m = n - i;
+    if(m > len)
+      m = len;
+    if(m > pi->nwrite - pi->nread)
+      m = pi->nwrite - pi->nread;
+    if(copyout(pr->pagetable, addr + i, src, m) == -1)
       break;
+    pi->nread += m;
+    i += m;
   }
   wakeup(&pi->nwrite);  //DOC: piperead-wakeup
   release(&pi->lock);
   return i;
 }
+
+// splice support: rather than copying through a user
+// buffer, a splice reserves one contiguous run of the pipe
+// buffer, drops the pipe lock while readi() or writei()
+// copies straight to or from it, then commits the bytes
+// it moved.  rbusy and wbusy keep other readers, writers
+// and resizes away from the run in the meantime.
+
+// wait for free space and reserve it for writing.
+// sets *dst to the start of the run and returns its
+// length, or returns -1 if the pipe has no reader.
+int
+pipewbegin(struct pipe *pi, char **dst)
+{
+  int len;
+  struct proc *pr = myproc();
+
+  acquire(&pi->lock);
+  while(pi->wbusy || pi->nwrite - pi->nread == pi->size){
+    if(pi->readopen == 0 || pr->killed){
+      release(&pi->lock);
+      return -1;
+    }
+    wakeup(&pi->nread);
+    sleep(&pi->nwrite, &pi->lock);
+  }
+  if(pi->readopen == 0 || pr->killed){
+    release(&pi->lock);
+    return -1;
+  }
+  *dst = piperun(pi, pi->nwrite, &len);
+  if(len > pi->size - (pi->nwrite - pi->nread))
+    len = pi->size - (pi->nwrite - pi->nread);
+  pi->wbusy = 1;
+  release(&pi->lock);
+  return len;
+}
+
+// release a run reserved by pipewbegin(),
+// making the first n bytes of it readable.
+void
+pipewend(struct pipe *pi, int n)
+{
+  acquire(&pi->lock);
+  pi->nwrite += n;
+  pi->wbusy = 0;
+  wakeup(&pi->nread);
+  wakeup(&pi->nwrite);
+  release(&pi->lock);
+}
+
+// reserve a run of buffered data for reading, waiting for
+// some to arrive only if wait is set.  sets *src to the
+// start of the run and returns its length, 0 at end of
+// file (or if empty and !wait), or -1 if killed.
+int
+piperbegin(struct pipe *pi, char **src, int wait)
+{
+  int len;
+  struct proc *pr = myproc();
+
+  acquire(&pi->lock);
+  while(pi->rbusy || (wait && pi->nread == pi->nwrite && pi->writeopen)){
+    if(pr->killed){
+      release(&pi->lock);
+      return -1;
+    }
+    sleep(&pi->nread, &pi->lock);
+  }
+  if(pi->nread == pi->nwrite){
+    release(&pi->lock);
+    return 0;
+  }
+  *src = piperun(pi, pi->nread, &len);
+  if(len > pi->nwrite - pi->nread)
+    len = pi->nwrite - pi->nread;
+  pi->rbusy = 1;
+  release(&pi->lock);
+  return len;
+}
+
+// release a run reserved by piperbegin(),
+// consuming the first n bytes of it.
+void
+piperend(struct pipe *pi, int n)
+{
+  acquire(&pi->lock);
+  pi->nread += n;
+  pi->rbusy = 0;
+  wakeup(&pi->nwrite);
+  wakeup(&pi->nread);
+  release(&pi->lock);
+}
+
+// capacity of the pipe, in bytes.
+int
+pipesize(struct pipe *pi)
+{
+  int size;
+
+  acquire(&pi->lock);
+  size = pi->size;
+  release(&pi->lock);
+  return size;
+}
+
+// resize the pipe to hold at least n bytes, rounded up to
+// a power-of-two number of pages.  fails if n is too large
+// or the pipe holds more data than would fit.
+// returns the new capacity.
+int
+pipesetsize(struct pipe *pi, int n)
+{
+  char *pg[PIPEMAXPAGES], *old[PIPEMAXPAGES];
+  int npages, oldpages, i, m, len;
+  uint count, off;
+  char *src;
+
+  if(n < 0 || n > PIPEMAXPAGES*PGSIZE)
+    return -1;
+  for(npages = 1; npages*PGSIZE < n; npages *= 2)
+    ;
+  if(pipepages(pg, npages) < 0)
+    return -1;
+
+  acquire(&pi->lock);
+  while(pi->rbusy || pi->wbusy)
+    sleep(&pi->nwrite, &pi->lock);
+  count = pi->nwrite - pi->nread;
+  if(count > npages*PGSIZE){
+    release(&pi->lock);
+    for(i = 0; i < npages; i++)
+      kfree(pg[i]);
+    return -1;
+  }
+  // move the unread bytes to the start of the new pages.
+  for(off = 0; off < count; off += m){
+    src = piperun(pi, pi->nread + off, &len);
+    m = count - off;
+    if(m > len)
+      m = len;
+    if(m > PGSIZE - off % PGSIZE)
+      m = PGSIZE - off % PGSIZE;
+    memmove(pg[off / PGSIZE] + off % PGSIZE, src, m);
+  }
+  oldpages = pi->size / PGSIZE;
+  for(i = 0; i < oldpages; i++)
+    old[i] = pi->pages[i];
+  for(i = 0; i < npages; i++)
+    pi->pages[i] = pg[i];
+  pi->size = npages*PGSIZE;
+  pi->nread = 0;
+  pi->nwrite = count;
+  wakeup(&pi->nwrite);
+  release(&pi->lock);
+
+  for(i = 0; i < oldpages; i++)
+    kfree(old[i]);
+  return npages*PGSIZE;
+}
@@ -0,0 +1,14 @@
+// poll() file descriptor readiness.
+// Both the kernel and user programs use this header file.
+
+#define POLLIN   0x01  // data to read, or end of file
+#define POLLOUT  0x04  // room to write
+#define POLLERR  0x08  // write end with no reader (always reported)
+#define POLLHUP  0x10  // pipe's writer has gone (always reported)
+#define POLLNVAL 0x20  // fd is not open (always reported)
+
+struct pollfd {
+  int fd;         // ignored if negative
+  short events;   // POLLIN and/or POLLOUT
+  short revents;  // set by poll()
+};
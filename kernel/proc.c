@@ -4,6 +4,7 @@
 #include "riscv.h"
 #include "spinlock.h"
 #include "proc.h"
+#include "trace.h"
 #include "defs.h"
 
 struct cpu cpus[NCPU];
@@ -15,8 +16,13 @@ struct proc *initproc;
 int nextpid = 1;
 struct spinlock pid_lock;
 
+// CPUs waiting in scheduler()'s wfi, a bit each.
+static uint64 idlecpus;
+
 extern void forkret(void);
 static void wakeup1(struct proc *chan);
+static void wakeidle(void);
+static int pollmatch(struct proc *p, void *chan);
 static void freeproc(struct proc *p);
 
 extern char trampoline[]; // trampoline.S
@@ -38,7 +44,7 @@ procinit(void)
       if(pa == 0)
         panic("kalloc");
       uint64 va = KSTACK((int) (p - proc));
-      kvmmap(va, (uint64)pa, PGSIZE, PTE_R | PTE_W);
+      kvmmap(va, (uint64)pa, PGSIZE, PTE_R | PTE_W);  // not PTE_G: see kvminit()
       p->kstack = va;
   }
   kvminithart();
@@ -121,6 +127,13 @@ found:
     return 0;
   }
 
+  // A kernel page table, which will map user memory too.
+  if((p->kpagetable = kvmcreate()) == 0){
+    freeproc(p);
+    release(&p->lock);
+    return 0;
+  }
+
   // Set up new context to start executing at forkret,
   // which returns to user space.
   memset(&p->context, 0, sizeof(p->context));
@@ -142,6 +155,15 @@ freeproc(struct proc *p)
   if(p->pagetable)
     proc_freepagetable(p->pagetable, p->sz);
   p->pagetable = 0;
+  if(p->kpagetable)
+    kvmfree(p->kpagetable);
+  p->kpagetable = 0;
+  p->guard = 0;
+  p->asid = 0;
+  p->kasid = 0;
+  p->asidgen = 0;
+  p->ring = 0;
+  p->ringpoll = 0;
   p->sz = 0;
   p->pid = 0;
   p->parent = 0;
@@ -169,7 +191,7 @@ proc_pagetable(struct proc *p)
   // only the supervisor uses it, on the way
   // to/from user space, so not PTE_U.
   if(mappages(pagetable, TRAMPOLINE, PGSIZE,
-              (uint64)trampoline, PTE_R | PTE_X) < 0){
+              (uint64)trampoline, PTE_R | PTE_X | PTE_G) < 0){
     uvmfree(pagetable, 0);
     return 0;
   }
@@ -182,6 +204,16 @@ proc_pagetable(struct proc *p)
     return 0;
   }
 
+  // map the clock page, shared by every process, so
+  // that the user can read but not write it.
+  if(mappages(pagetable, CLOCKPAGE, PGSIZE,
+              (uint64)clockpage, PTE_R | PTE_U) < 0){
+    uvmunmap(pagetable, TRAPFRAME, 1, 0);
+    uvmunmap(pagetable, TRAMPOLINE, 1, 0);
+    uvmfree(pagetable, 0);
+    return 0;
+  }
+
   return pagetable;
 }
 
@@ -192,6 +224,8 @@ proc_freepagetable(pagetable_t pagetable, uint64 sz)
 {
   uvmunmap(pagetable, TRAMPOLINE, 1, 0);
   uvmunmap(pagetable, TRAPFRAME, 1, 0);
+  uvmunmap(pagetable, CLOCKPAGE, 1, 0);
+  ringfree(pagetable);
   uvmfree(pagetable, sz);
 }
 
@@ -220,6 +254,7 @@ userinit(void)
   // and data into it.
   uvminit(p->pagetable, initcode, sizeof(initcode));
   p->sz = PGSIZE;
+  kvmsync(p);
 
   // prepare for the very first "return" from kernel to user.
   p->trapframe->epc = 0;      // user program counter
@@ -243,13 +278,20 @@ growproc(int n)
 
   sz = p->sz;
   if(n > 0){
+    if((uint64)sz + n > MAXUVA)
+      return -1;
     if((sz = uvmalloc(p->pagetable, sz, sz + n)) == 0) {
+      kvmsync(p);  // a failed uvmalloc() may have come and gone
       return -1;
     }
   } else if(n < 0){
-    sz = uvmdealloc(p->pagetable, sz, sz + n);
+    if((sz = uvmdealloc(p->pagetable, sz, sz + n)) == p->sz) {
+      kvmsync(p);  // out of memory splitting a megapage
+      return -1;
+    }
   }
   p->sz = sz;
+  kvmsync(p);
   return 0;
 }
 
@@ -274,6 +316,8 @@ fork(void)
     return -1;
   }
   np->sz = p->sz;
+  np->guard = p->guard;
+  kvmsync(np);
 
   np->parent = p;
 
@@ -294,6 +338,7 @@ fork(void)
   pid = np->pid;
 
   np->state = RUNNABLE;
+  wakeidle();
 
   release(&np->lock);
 
@@ -446,6 +491,27 @@ wait(uint64 addr)
   }
 }
 
+// A process has just become RUNNABLE: if another CPU is
+// idle, send it an IPI so that it can run the process.
+// Interrupts are off (a p->lock is held).
+static void
+wakeidle(void)
+{
+  uint64 idle, bit;
+  int i;
+
+  __sync_synchronize();  // order the RUNNABLE before reading idlecpus
+  idle = idlecpus & ~(1L << cpuid());
+  if(idle == 0)
+    return;
+  for(i = 0; (idle & (1L << i)) == 0; i++)
+    ;
+  // claim CPU i, so that it gets only one IPI.
+  bit = 1L << i;
+  if(__sync_fetch_and_and(&idlecpus, ~bit) & bit)
+    ipi(i);
+}
+
 // Per-CPU process scheduler.
 // Each CPU calls scheduler() after setting itself up.
 // Scheduler never returns.  It loops, doing:
@@ -458,6 +524,7 @@ scheduler(void)
 {
   struct proc *p;
   struct cpu *c = mycpu();
+  uint64 t0;
   
   c->proc = 0;
   for(;;){
@@ -473,7 +540,16 @@ scheduler(void)
         // before jumping back to us.
         p->state = RUNNING;
         c->proc = p;
+        c->quantumend = r_time() + QUANTUM;
+        timerarm();
+        ktrace(TR_SCHED, p->pid, 0);
+        kvmswitch(p);
         swtch(&c->context, &p->context);
+        kvmswitch(0);
+        // swtch() doesn't save sstatus: a process preempted
+        // inside a direct copyout() left SUM set.  kerneltrap()
+        // puts it back when that process resumes.
+        w_sstatus(r_sstatus() & ~SSTATUS_SUM);
 
         // Process is done running for now.
         // It should have changed its p->state before coming back.
@@ -484,8 +560,25 @@ scheduler(void)
       release(&p->lock);
     }
     if(found == 0) {
-      intr_on();
-      asm volatile("wfi");
+      // wait for an interrupt, with no timer interrupt
+      // unless a sleeper's deadline needs one.  with
+      // interrupts off, one that makes a process RUNNABLE
+      // after the check below stays pending, and wfi
+      // returns at once; the intr_on() above takes it.
+      // a CPU that makes one RUNNABLE after the check
+      // sees this one in idlecpus, and sends it an IPI.
+      intr_off();
+      __sync_fetch_and_or(&idlecpus, 1L << cpuid());
+      for(p = proc; p < &proc[NPROC]; p++)
+        if(p->state == RUNNABLE)
+          break;
+      if(p == &proc[NPROC]){
+        timerarm();
+        t0 = r_time();
+        asm volatile("wfi");
+        c->idletime += r_time() - t0;
+      }
+      __sync_fetch_and_and(&idlecpus, ~(1L << cpuid()));
     }
   }
 }
@@ -570,6 +663,7 @@ sleep(void *chan, struct spinlock *lk)
   // Go to sleep.
   p->chan = chan;
   p->state = SLEEPING;
+  ktrace(TR_SLEEP, (uint64)chan, 0);
 
   sched();
 
@@ -594,11 +688,88 @@ wakeup(void *chan)
     acquire(&p->lock);
     if(p->state == SLEEPING && p->chan == chan) {
       p->state = RUNNABLE;
+      ktrace(TR_WAKEUP, (uint64)chan, p->pid);
+      wakeidle();
+    } else if(p->npollchan > 0 && pollmatch(p, chan)) {
+      p->pollwoken = 1;
+      if(p->state == SLEEPING){
+        p->state = RUNNABLE;
+        ktrace(TR_WAKEUP, (uint64)chan, p->pid);
+        wakeidle();
+      }
     }
     release(&p->lock);
   }
 }
 
+// poll() support.  While in poll(), a process registers,
+// with pollwait(), each channel whose wakeup() could mean
+// one of its fds has become ready.  wakeup() on any of them
+// sets p->pollwoken and makes the process runnable,
+// whatever it is sleeping on.
+
+// is chan one of p's poll channels?
+// p->lock must be held.
+static int
+pollmatch(struct proc *p, void *chan)
+{
+  int i;
+
+  for(i = 0; i < p->npollchan; i++)
+    if(p->pollchan[i] == chan)
+      return 1;
+  return 0;
+}
+
+// register chan for the poll() in progress.
+void
+pollwait(void *chan)
+{
+  struct proc *p = myproc();
+
+  acquire(&p->lock);
+  if(!pollmatch(p, chan)){
+    if(p->npollchan >= NPOLLCHAN)
+      panic("pollwait");
+    p->pollchan[p->npollchan++] = chan;
+  }
+  release(&p->lock);
+}
+
+// forget the channels registered by the last poll() pass.
+void
+pollclear(void)
+{
+  struct proc *p = myproc();
+
+  acquire(&p->lock);
+  p->npollchan = 0;
+  p->pollwoken = 0;
+  release(&p->lock);
+}
+
+// sleep until a poll channel is woken, the process
+// is killed, or the time reaches deadline (if timed).
+void
+pollsleep(int timed, uint64 deadline)
+{
+  struct proc *p = myproc();
+
+  acquire(&p->lock);
+  while(!p->pollwoken && !p->killed){
+    if(timed){
+      if(r_time() >= deadline)
+        break;
+      timerwait(deadline);
+      sleep(&ticks, &p->lock);
+    } else {
+      sleep(p, &p->lock);  // nothing else wakes this channel
+    }
+  }
+  p->pollwoken = 0;
+  release(&p->lock);
+}
+
 // Wake up p if it is sleeping in wait(); used by exit().
 // Caller must hold p->lock.
 static void
@@ -608,6 +779,7 @@ wakeup1(struct proc *p)
     panic("wakeup1");
   if(p->chan == p && p->state == SLEEPING) {
     p->state = RUNNABLE;
+    wakeidle();
   }
 }
 
@@ -626,6 +798,7 @@ kill(int pid)
       if(p->state == SLEEPING){
         // Wake process from sleep().
         p->state = RUNNABLE;
+        wakeidle();
       }
       release(&p->lock);
       return 0;
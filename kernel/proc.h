@@ -24,6 +24,10 @@ struct cpu {
   struct context context;     // swtch() here to enter scheduler().
   int noff;                   // Depth of push_off() nesting.
   int intena;                 // Were interrupts enabled before push_off()?
+  uint64 asidgen;             // ASID generation the TLB was last flushed for
+  uint64 quantumend;          // time at which proc must yield
+  uint64 timerat;             // time of the next timer interrupt asked for
+  uint64 idletime;            // timer cycles spent waiting in scheduler()
 };
 
 extern struct cpu cpus[NCPU];
@@ -83,6 +87,18 @@ struct trapframe {
 enum procstate { UNUSED, SLEEPING, RUNNABLE, RUNNING, ZOMBIE };
 
 // Per-process state
+#define NPOLLCHAN (2*NOFILE)  // a pipe fd may register two channels
+
+// the last user page translated by copyin()/copyout(),
+// valid while gen matches vm.c's generation counter.
+struct vmcache {
+  pagetable_t pagetable;
+  uint64 va;
+  uint64 pa;
+  int writable;
+  uint64 gen;
+};
+
 struct proc {
   struct spinlock lock;
 
@@ -98,9 +114,22 @@ struct proc {
   uint64 kstack;               // Virtual address of kernel stack
   uint64 sz;                   // Size of process memory (bytes)
   pagetable_t pagetable;       // User page table
+  pagetable_t kpagetable;      // Kernel page table, with user memory too
+  uint64 guard;                // User stack guard page, or 0
+  int asid, kasid;             // ASIDs of pagetable and kpagetable
+  uint64 asidgen;              // generation they belong to
+  int asidcpu;                 // CPU that last ran the process
   struct trapframe *trapframe; // data page for trampoline.S
   struct context context;      // swtch() here to run process
   struct file *ofile[NOFILE];  // Open files
   struct inode *cwd;           // Current directory
   char name[16];               // Process name (debugging)
+  struct vmcache vmcache;      // copyin/copyout translation cache
+  struct ioring *ring;         // submission/completion ring, or 0
+  int ringpoll;                // drain ring on every kernel entry
+
+  // p->lock must be held when using these:
+  void *pollchan[NPOLLCHAN];   // channels poll() is waiting on
+  int npollchan;
+  int pollwoken;               // one of them has been woken
 };
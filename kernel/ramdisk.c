@@ -1,5 +1,7 @@
 //
-// ramdisk that uses the disk image loaded by qemu -initrd fs.img
+// ramdisk that uses the disk image loaded by qemu
+// (make RAMDISK=1) at the top of physical memory.
+// bread() and bwrite() are a memmove.
 //
 
 #include "types.h"
@@ -12,34 +14,38 @@
 #include "fs.h"
 #include "buf.h"
 
+// the Makefile tells qemu to load fs.img here.
+#define RAMDISK (PHYSTOP - PGROUNDUP(FSSIZE*BSIZE))
+
+char *ramdisk;  // the image, or 0 to use the virtio disk
+
+// look for a file system image in memory; called
+// before kinit() so that the image isn't freed.
 void
 ramdiskinit(void)
 {
+  struct superblock *sb = (struct superblock*)(RAMDISK + BSIZE);
+
+  if(sb->magic == FSMAGIC && sb->size <= FSSIZE){
+    ramdisk = (char*)RAMDISK;
+    printf("ramdisk: %d blocks at %p\n", sb->size, ramdisk);
+  }
 }
 
-// If B_DIRTY is set, write buf to disk, clear B_DIRTY, set B_VALID.
-// Else if B_VALID is not set, read buf from disk, set B_VALID.
+// read (write == 0) or write buf b.
 void
-ramdiskrw(struct buf *b)
+ramdiskrw(struct buf *b, int write)
 {
+  char *addr;
+
   if(!holdingsleep(&b->lock))
     panic("ramdiskrw: buf not locked");
-  if((b->flags & (B_VALID|B_DIRTY)) == B_VALID)
-    panic("ramdiskrw: nothing to do");
-
   if(b->blockno >= FSSIZE)
     panic("ramdiskrw: blockno too big");
 
-  uint64 diskaddr = b->blockno * BSIZE;
-  char *addr = (char *)RAMDISK + diskaddr;
-
-  if(b->flags & B_DIRTY){
-    // write
+  addr = ramdisk + b->blockno * BSIZE;
+  if(write)
     memmove(addr, b->data, BSIZE);
-    b->flags &= ~B_DIRTY;
-  } else {
-    // read
+  else
     memmove(b->data, addr, BSIZE);
-    b->flags |= B_VALID;
-  }
 }
@@ -0,0 +1,246 @@
+// Small-object allocator, for kernel structures that
+// need much less than a page: pipes, open files, inodes.
+//
+// kmalloc(n) hands out objects from one of NCACHE power-of-
+// two size classes, 32 to 1024 bytes.  Each class
+// carves kalloc()'d pages (slabs) into equal objects; a slab
+// page starts with a struct slab, so kmfree() finds an
+// object's class from its page.  In front of the slabs each
+// CPU keeps a magazine of free objects, used with interrupts
+// off and no lock; only when a magazine is empty or full
+// does a CPU take the class lock to move half a magazine's
+// worth to or from the slabs.
+//
+// A slab whose objects are all free goes back to kalloc(),
+// except for one spare per class.  kalloc() calls
+// slabreclaim() to release the spares when it runs out.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "spinlock.h"
+#include "riscv.h"
+#include "proc.h"
+#include "defs.h"
+
+#define NCACHE  6    // 32, 64, ..., 1024 bytes
+#define MINOBJ  32
+#define MAGSIZE 16   // objects per per-CPU magazine
+
+struct slab {
+  struct slab *next;     // on the cache's list, if it has free objects
+  struct cache *cache;
+  void *free;            // this slab's free objects
+  int nfree;
+};
+
+struct magazine {
+  int n;
+  void *obj[MAGSIZE];
+};
+
+struct cache {
+  struct spinlock lock;
+  uint size;             // object size
+  int perslab;           // objects per slab
+  struct slab *slabs;    // slabs with free objects
+  int nspare;            // slabs on the list with every object free
+  struct magazine mag[NCPU];
+};
+
+static struct cache caches[NCACHE];
+
+// objects start after the slab header, 8-byte aligned.
+#define SLABHDR ((sizeof(struct slab) + 7) & ~7)
+
+void
+slabinit(void)
+{
+  int i;
+
+  for(i = 0; i < NCACHE; i++){
+    initlock(&caches[i].lock, "slab");
+    caches[i].size = MINOBJ << i;
+    caches[i].perslab = (PGSIZE - SLABHDR) / caches[i].size;
+  }
+}
+
+// carve a new page into free objects and put it on c's list.
+// caller holds c->lock, which is released around kalloc():
+// when out of memory, kalloc() calls slabreclaim(), which
+// takes every class's lock.
+static int
+slabgrow(struct cache *c)
+{
+  struct slab *s;
+  char *o;
+  int i;
+
+  release(&c->lock);
+  s = (struct slab*)kalloc();
+  acquire(&c->lock);
+  if(s == 0)
+    return -1;
+  if(c->slabs){
+    // another CPU grew c meanwhile.
+    kfree((char*)s);
+    return 0;
+  }
+  s->cache = c;
+  s->free = 0;
+  for(i = c->perslab - 1; i >= 0; i--){
+    o = (char*)s + SLABHDR + i*c->size;
+    *(void**)o = s->free;
+    s->free = o;
+  }
+  s->nfree = c->perslab;
+  s->next = c->slabs;
+  c->slabs = s;
+  c->nspare++;
+  return 0;
+}
+
+// move up to n objects from c's slabs to magazine m.
+// caller holds c->lock, and has interrupts off.
+static void
+slabtake(struct cache *c, struct magazine *m, int n)
+{
+  struct slab *s;
+
+  while(m->n < n){
+    if(c->slabs == 0 && slabgrow(c) < 0)
+      return;
+    s = c->slabs;
+    if(s->nfree == c->perslab)
+      c->nspare--;
+    m->obj[m->n++] = s->free;
+    s->free = *(void**)s->free;
+    if(--s->nfree == 0)
+      c->slabs = s->next;   // full: off the list until a free
+  }
+}
+
+// unlink slab s from c's list.  caller holds c->lock.
+static void
+slabunlink(struct cache *c, struct slab *s)
+{
+  struct slab **pp;
+
+  for(pp = &c->slabs; *pp != s; pp = &(*pp)->next)
+    ;
+  *pp = s->next;
+}
+
+// return objects from magazine m to their slabs until
+// m holds n, freeing slabs that become empty past the
+// first spare.  caller holds c->lock.
+static void
+slabgive(struct cache *c, struct magazine *m, int n)
+{
+  struct slab *s;
+  void *o;
+
+  while(m->n > n){
+    o = m->obj[--m->n];
+    s = (struct slab*)PGROUNDDOWN((uint64)o);
+    *(void**)o = s->free;
+    s->free = o;
+    if(s->nfree++ == 0){
+      s->next = c->slabs;
+      c->slabs = s;
+    }
+    if(s->nfree == c->perslab){
+      if(c->nspare > 0){
+        slabunlink(c, s);
+        kfree((char*)s);
+      } else
+        c->nspare++;
+    }
+  }
+}
+
+static struct cache*
+cachefor(uint n)
+{
+  int i;
+
+  for(i = 0; i < NCACHE; i++)
+    if(n <= caches[i].size)
+      return &caches[i];
+  return 0;
+}
+
+// Allocate n bytes, n no more than the largest class.
+// Returns 0 if out of memory.  The object is not zeroed.
+void*
+kmalloc(uint n)
+{
+  struct cache *c;
+  struct magazine *m;
+  void *o;
+
+  if((c = cachefor(n)) == 0)
+    panic("kmalloc: too big");
+
+  push_off();
+  m = &c->mag[cpuid()];
+  if(m->n == 0){
+    acquire(&c->lock);
+    slabtake(c, m, MAGSIZE/2);
+    release(&c->lock);
+  }
+  o = m->n > 0 ? m->obj[--m->n] : 0;
+  pop_off();
+  return o;
+}
+
+// Free an object returned by kmalloc().
+void
+kmfree(void *o)
+{
+  struct cache *c;
+  struct magazine *m;
+
+  c = ((struct slab*)PGROUNDDOWN((uint64)o))->cache;
+  if(c < caches || c >= &caches[NCACHE])
+    panic("kmfree");
+
+  push_off();
+  m = &c->mag[cpuid()];
+  if(m->n == MAGSIZE){
+    acquire(&c->lock);
+    slabgive(c, m, MAGSIZE/2);
+    release(&c->lock);
+  }
+  m->obj[m->n++] = o;
+  pop_off();
+}
+
+// give this CPU's cached objects and every spare slab back
+// to kalloc().  returns the number of pages freed.
+int
+slabreclaim(void)
+{
+  struct cache *c;
+  struct slab *s, **pp;
+  int freed;
+
+  freed = 0;
+  push_off();
+  for(c = caches; c < &caches[NCACHE]; c++){
+    acquire(&c->lock);
+    slabgive(c, &c->mag[cpuid()], 0);
+    for(pp = &c->slabs; (s = *pp) != 0; ){
+      if(s->nfree == c->perslab){
+        *pp = s->next;
+        c->nspare--;
+        kfree((char*)s);
+        freed++;
+      } else
+        pp = &s->next;
+    }
+    release(&c->lock);
+  }
+  pop_off();
+  return freed;
+}
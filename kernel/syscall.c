@@ -5,6 +5,8 @@
 #include "spinlock.h"
 #include "proc.h"
 #include "syscall.h"
+#include "sysstat.h"
+#include "trace.h"
 #include "defs.h"
 
 // Fetch the uint64 at addr from the current process.
@@ -104,6 +106,23 @@ extern uint64 sys_unlink(void);
 extern uint64 sys_wait(void);
 extern uint64 sys_write(void);
 extern uint64 sys_uptime(void);
+extern uint64 sys_sysstat(void);
+extern uint64 sys_tracectl(void);
+extern uint64 sys_traceread(void);
+extern uint64 sys_fcntl(void);
+extern uint64 sys_splice(void);
+extern uint64 sys_mount(void);
+extern uint64 sys_readv(void);
+extern uint64 sys_writev(void);
+extern uint64 sys_pread(void);
+extern uint64 sys_pwrite(void);
+extern uint64 sys_lseek(void);
+extern uint64 sys_ringsetup(void);
+extern uint64 sys_ringenter(void);
+extern uint64 sys_poll(void);
+extern uint64 sys_getdents(void);
+extern uint64 sys_clock_gettime(void);
+extern uint64 sys_idletime(void);
 
 static uint64 (*syscalls[])(void) = {
 [SYS_fork]    sys_fork,
@@ -127,8 +146,73 @@ static uint64 (*syscalls[])(void) = {
 [SYS_link]    sys_link,
 [SYS_mkdir]   sys_mkdir,
 [SYS_close]   sys_close,
+[SYS_sysstat] sys_sysstat,
+[SYS_tracectl]  sys_tracectl,
+[SYS_traceread] sys_traceread,
+[SYS_fcntl]   sys_fcntl,
+[SYS_splice]  sys_splice,
+[SYS_mount]   sys_mount,
+[SYS_readv]   sys_readv,
+[SYS_writev]  sys_writev,
+[SYS_pread]   sys_pread,
+[SYS_pwrite]  sys_pwrite,
+[SYS_lseek]   sys_lseek,
+[SYS_ringsetup] sys_ringsetup,
+[SYS_ringenter] sys_ringenter,
+[SYS_poll]    sys_poll,
+[SYS_getdents] sys_getdents,
+[SYS_clock_gettime] sys_clock_gettime,
+[SYS_idletime] sys_idletime,
 };
 
+// per-CPU, per-system-call counters, so that
+// accounting never contends for a lock.
+static struct sysstat sysstats[NCPU][NELEM(syscalls)];
+
+// charge one call of system call num, which took
+// cycles timer cycles and returned ret, to this CPU.
+static void
+sysaccount(int num, uint64 ret, uint64 cycles)
+{
+  struct sysstat *st;
+  int b;
+
+  push_off();
+  st = &sysstats[cpuid()][num];
+  st->count++;
+  if(ret == -1)
+    st->errors++;
+  st->cycles += cycles;
+  for(b = 0; (cycles >>= 1) != 0 && b < NSYSHIST-1; b++)
+    ;
+  st->hist[b]++;
+  pop_off();
+}
+
+// copy the counters for system call num into *st,
+// from a single CPU, or summed over all CPUs if cpu < 0.
+// returns -1 if there is no such system call or CPU.
+int
+sysstatread(int cpu, int num, struct sysstat *st)
+{
+  int c, i;
+
+  if(num < 0 || num >= NELEM(syscalls) || cpu >= NCPU)
+    return -1;
+  memset(st, 0, sizeof(*st));
+  for(c = 0; c < NCPU; c++){
+    if(cpu >= 0 && c != cpu)
+      continue;
+    // racy with concurrent updates, but these are only statistics.
+    st->count += sysstats[c][num].count;
+    st->errors += sysstats[c][num].errors;
+    st->cycles += sysstats[c][num].cycles;
+    for(i = 0; i < NSYSHIST; i++)
+      st->hist[i] += sysstats[c][num].hist[i];
+  }
+  return 0;
+}
+
 void
 syscall(void)
 {
@@ -137,7 +221,11 @@ syscall(void)
 
   num = p->trapframe->a7;
   if(num > 0 && num < NELEM(syscalls) && syscalls[num]) {
+    uint64 t0 = r_time();
+    ktrace(TR_SYSCALL, num, 0);
     p->trapframe->a0 = syscalls[num]();
+    ktrace(TR_SYSRET, num, p->trapframe->a0);
+    sysaccount(num, p->trapframe->a0, r_time() - t0);
   } else {
     printf("%d %s: unknown sys call %d\n",
             p->pid, p->name, num);
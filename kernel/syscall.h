@@ -20,3 +20,20 @@
 #define SYS_link   19
 #define SYS_mkdir  20
 #define SYS_close  21
+#define SYS_sysstat 22
+#define SYS_tracectl  23
+#define SYS_traceread 24
+#define SYS_fcntl   25
+#define SYS_splice  26
+#define SYS_mount   27
+#define SYS_readv   28
+#define SYS_writev  29
+#define SYS_pread   30
+#define SYS_pwrite  31
+#define SYS_lseek   32
+#define SYS_ringsetup 33
+#define SYS_ringenter 34
+#define SYS_poll    35
+#define SYS_getdents 36
+#define SYS_clock_gettime 37
+#define SYS_idletime 38
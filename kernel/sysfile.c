@@ -15,6 +15,8 @@
 #include "sleeplock.h"
 #include "file.h"
 #include "fcntl.h"
+#include "iovec.h"
+#include "poll.h"
 
 // Fetch the nth word-sized system call argument as a file descriptor
 // and return both the descriptor and the corresponding struct file.
@@ -91,6 +93,159 @@ sys_write(void)
   return filewrite(f, p, n);
 }
 
+// read at an offset without moving the file's offset.
+uint64
+sys_pread(void)
+{
+  struct file *f;
+  int n, off;
+  uint64 p;
+
+  if(argfd(0, 0, &f) < 0 || argaddr(1, &p) < 0 || argint(2, &n) < 0 ||
+     argint(3, &off) < 0 || off < 0)
+    return -1;
+  return filepread(f, p, n, off);
+}
+
+// write at an offset without moving the file's offset.
+uint64
+sys_pwrite(void)
+{
+  struct file *f;
+  int n, off;
+  uint64 p;
+
+  if(argfd(0, 0, &f) < 0 || argaddr(1, &p) < 0 || argint(2, &n) < 0 ||
+     argint(3, &off) < 0 || off < 0)
+    return -1;
+  return filepwrite(f, p, n, off);
+}
+
+uint64
+sys_lseek(void)
+{
+  struct file *f;
+  int off, whence;
+
+  if(argfd(0, 0, &f) < 0 || argint(1, &off) < 0 || argint(2, &whence) < 0)
+    return -1;
+  return fileseek(f, off, whence);
+}
+
+uint64
+sys_getdents(void)
+{
+  struct file *f;
+  uint64 addr;
+  int n, flags;
+
+  if(argfd(0, 0, &f) < 0 || argaddr(1, &addr) < 0 || argint(2, &n) < 0 || argint(3, &flags) < 0)
+    return -1;
+  return filegetdents(f, addr, n, flags);
+}
+
+// poll(fds, nfds, timeout): wait until one of the fds is
+// ready for the events asked for, or timeout clock ticks
+// have passed (forever if timeout is negative).  fills in
+// each revents and returns the number of ready fds.
+uint64
+sys_poll(void)
+{
+  struct pollfd fds[NOFILE];
+  struct proc *p = myproc();
+  uint64 addr;
+  int i, n, nfds, timeout, ready;
+  uint64 deadline;
+
+  if(argaddr(0, &addr) < 0 || argint(1, &nfds) < 0 || argint(2, &timeout) < 0)
+    return -1;
+  if(nfds < 0 || nfds > NOFILE)
+    return -1;
+  if(copyin(p->pagetable, (char*)fds, addr, nfds*sizeof(fds[0])) < 0)
+    return -1;
+
+  deadline = r_time() + (uint64)timeout * TICKCYCLES;
+  for(;;){
+    pollclear();
+    ready = 0;
+    for(i = 0; i < nfds; i++){
+      fds[i].revents = 0;
+      if(fds[i].fd < 0)
+        continue;
+      if(fds[i].fd >= NOFILE || p->ofile[fds[i].fd] == 0)
+        n = POLLNVAL;
+      else
+        n = filepoll(p->ofile[fds[i].fd]);
+      fds[i].revents = n & (fds[i].events|POLLERR|POLLHUP|POLLNVAL);
+      if(fds[i].revents)
+        ready++;
+    }
+    if(ready || timeout == 0 || p->killed)
+      break;
+    if(timeout > 0 && r_time() >= deadline)
+      break;
+    pollsleep(timeout > 0, deadline);
+  }
+  pollclear();
+
+  if(p->killed)
+    return -1;
+  if(copyout(p->pagetable, addr, (char*)fds, nfds*sizeof(fds[0])) < 0)
+    return -1;
+  return ready;
+}
+
+// fetch the iovcnt-element iovec array at user address
+// addr, checking that the total length fits in an int.
+static int
+argiovec(uint64 addr, int iovcnt, struct iovec *iov)
+{
+  uint64 tot;
+  int i;
+
+  if(iovcnt < 0 || iovcnt > IOV_MAX)
+    return -1;
+  if(copyin(myproc()->pagetable, (char*)iov, addr, iovcnt*sizeof(iov[0])) < 0)
+    return -1;
+  tot = 0;
+  for(i = 0; i < iovcnt; i++){
+    tot += iov[i].iov_len;
+    if(iov[i].iov_len > 0x7fffffff || tot > 0x7fffffff)
+      return -1;
+  }
+  return 0;
+}
+
+uint64
+sys_readv(void)
+{
+  struct file *f;
+  struct iovec iov[IOV_MAX];
+  int iovcnt;
+  uint64 p;
+
+  if(argfd(0, 0, &f) < 0 || argaddr(1, &p) < 0 || argint(2, &iovcnt) < 0)
+    return -1;
+  if(argiovec(p, iovcnt, iov) < 0)
+    return -1;
+  return filereadv(f, iov, iovcnt);
+}
+
+uint64
+sys_writev(void)
+{
+  struct file *f;
+  struct iovec iov[IOV_MAX];
+  int iovcnt;
+  uint64 p;
+
+  if(argfd(0, 0, &f) < 0 || argaddr(1, &p) < 0 || argint(2, &iovcnt) < 0)
+    return -1;
+  if(argiovec(p, iovcnt, iov) < 0)
+    return -1;
+  return filewritev(f, iov, iovcnt);
+}
+
 uint64
 sys_close(void)
 {
@@ -115,6 +270,38 @@ sys_fstat(void)
   return filestat(f, st);
 }
 
+uint64
+sys_fcntl(void)
+{
+  struct file *f;
+  int cmd, arg;
+
+  if(argfd(0, 0, &f) < 0 || argint(1, &cmd) < 0 || argint(2, &arg) < 0)
+    return -1;
+  if(f->type != FD_PIPE)
+    return -1;
+  switch(cmd){
+  case F_GETPIPE_SZ:
+    return pipesize(f->pipe);
+  case F_SETPIPE_SZ:
+    return pipesetsize(f->pipe, arg);
+  }
+  return -1;
+}
+
+// move up to n bytes from fdin to fdout inside the kernel.
+// one of them must be a pipe and the other a file.
+uint64
+sys_splice(void)
+{
+  struct file *in, *out;
+  int n;
+
+  if(argfd(0, 0, &in) < 0 || argfd(1, 0, &out) < 0 || argint(2, &n) < 0)
+    return -1;
+  return filesplice(in, out, n);
+}
+
 // Create the path new as a link to the same inode as old.
 uint64
 sys_link(void)
@@ -210,7 +397,7 @@ sys_unlink(void)
 
   if(ip->nlink < 1)
     panic("unlink: nlink < 1");
-  if(ip->type == T_DIR && !isdirempty(ip)){
+  if(ip->type == T_DIR && (!isdirempty(ip) || ismountpoint(ip))){
     iunlockput(ip);
     goto bad;
   }
@@ -258,8 +445,10 @@ create(char *path, short type, short major, short minor)
     return 0;
   }
 
-  if((ip = ialloc(dp->dev, type)) == 0)
-    panic("create: ialloc");
+  if((ip = ialloc(dp->dev, type)) == 0){
+    iunlockput(dp);
+    return 0;
+  }
 
   ilock(ip);
   ip->major = major;
@@ -283,17 +472,14 @@ create(char *path, short type, short major, short minor)
   return ip;
 }
 
-uint64
-sys_open(void)
+// open path with mode omode in the current process;
+// returns the new file descriptor, or -1.
+int
+fileopen(char *path, int omode)
 {
-  char path[MAXPATH];
-  int fd, omode;
+  int fd;
   struct file *f;
   struct inode *ip;
-  int n;
-
-  if((n = argstr(0, path, MAXPATH)) < 0 || argint(1, &omode) < 0)
-    return -1;
 
   begin_op();
 
@@ -351,6 +537,17 @@ sys_open(void)
   return fd;
 }
 
+uint64
+sys_open(void)
+{
+  char path[MAXPATH];
+  int omode;
+
+  if(argstr(0, path, MAXPATH) < 0 || argint(1, &omode) < 0)
+    return -1;
+  return fileopen(path, omode);
+}
+
 uint64
 sys_mkdir(void)
 {
@@ -484,3 +681,56 @@ sys_pipe(void)
   }
   return 0;
 }
+
+// mount a file system of type fstype on directory path.
+// the only type is "tmpfs", which can be mounted once.
+uint64
+sys_mount(void)
+{
+  char path[MAXPATH], fstype[DIRSIZ];
+  struct inode *ip;
+
+  if(argstr(0, path, MAXPATH) < 0 || argstr(1, fstype, DIRSIZ) < 0)
+    return -1;
+  if(strncmp(fstype, "tmpfs", DIRSIZ) != 0)
+    return -1;
+
+  begin_op();
+  if((ip = namei(path)) == 0){
+    end_op();
+    return -1;
+  }
+  ilock(ip);
+  if(ip->type != T_DIR || (ip->dev == ROOTDEV && ip->inum == ROOTINO)){
+    iunlockput(ip);
+    end_op();
+    return -1;
+  }
+  iunlock(ip);
+  if(mount(ip, TMPDEV) < 0){
+    iput(ip);
+    end_op();
+    return -1;
+  }
+  end_op();
+  return 0;
+}
+
+// map a submission/completion ring (see ioring.h) into
+// the process; returns its address.
+uint64
+sys_ringsetup(void)
+{
+  int flags;
+
+  if(argint(0, &flags) < 0)
+    return -1;
+  return ringsetup(flags);
+}
+
+// run the queued ring submissions now.
+uint64
+sys_ringenter(void)
+{
+  return ringdrain();
+}
@@ -6,6 +6,8 @@
 #include "memlayout.h"
 #include "spinlock.h"
 #include "proc.h"
+#include "sysstat.h"
+#include "clock.h"
 
 uint64
 sys_exit(void)
@@ -56,17 +58,18 @@ uint64
 sys_sleep(void)
 {
   int n;
-  uint ticks0;
+  uint64 deadline;
 
   if(argint(0, &n) < 0)
     return -1;
+  deadline = r_time() + (uint64)(uint)n * TICKCYCLES;
   acquire(&tickslock);
-  ticks0 = ticks;
-  while(ticks - ticks0 < n){
+  while(r_time() < deadline){
     if(myproc()->killed){
       release(&tickslock);
       return -1;
     }
+    timerwait(deadline);
     sleep(&ticks, &tickslock);
   }
   release(&tickslock);
@@ -83,15 +86,97 @@ sys_kill(void)
   return kill(pid);
 }
 
-// return how many clock tick interrupts have occurred
+// return how many clock ticks have passed
 // since start.
 uint64
 sys_uptime(void)
 {
-  uint xticks;
+  return tickcount();
+}
 
-  acquire(&tickslock);
-  xticks = ticks;
-  release(&tickslock);
-  return xticks;
+// clock_gettime(clock, ns): store the time on clock, in
+// nanoseconds, at ns.  user code can read the same clock
+// without a system call: see uptimens() in ulib.c.
+uint64
+sys_clock_gettime(void)
+{
+  int clock;
+  uint64 addr, ns;
+
+  if(argint(0, &clock) < 0 || argaddr(1, &addr) < 0)
+    return -1;
+  if(clock != CLOCK_MONOTONIC)
+    return -1;
+  ns = clockns(r_time() - clockpage->boottime, clockpage->freq);
+  if(copyout(myproc()->pagetable, addr, (char *)&ns, sizeof(ns)) < 0)
+    return -1;
+  return 0;
+}
+
+// idletime(ns, n): copy up to n CPUs' time spent idle,
+// in nanoseconds, to the array ns.  returns how many.
+uint64
+sys_idletime(void)
+{
+  uint64 addr, ns;
+  int i, n;
+
+  if(argaddr(0, &addr) < 0 || argint(1, &n) < 0)
+    return -1;
+  for(i = 0; i < n && i < NCPU; i++){
+    ns = clockns(cpus[i].idletime, clockpage->freq);
+    if(copyout(myproc()->pagetable, addr + i*sizeof(ns), (char *)&ns, sizeof(ns)) < 0)
+      return -1;
+  }
+  return i;
+}
+
+// copy per-system-call statistics to the user array
+// st[0..n-1], indexed by system call number, for one
+// CPU or summed over all CPUs if cpu < 0.
+// returns the number of entries copied, or -1 if
+// there is no such CPU.
+uint64
+sys_sysstat(void)
+{
+  int cpu, n, num;
+  uint64 addr;
+  struct sysstat st;
+
+  if(argint(0, &cpu) < 0 || argaddr(1, &addr) < 0 || argint(2, &n) < 0)
+    return -1;
+  if(cpu >= NCPU)
+    return -1;
+  for(num = 0; num < n; num++){
+    if(sysstatread(cpu, num, &st) < 0)
+      break;
+    if(copyout(myproc()->pagetable, addr + num*sizeof(st), (char *)&st, sizeof(st)) < 0)
+      return -1;
+  }
+  return num;
+}
+
+// turn kernel event tracing on (1) or off (0).
+// returns the previous setting.
+uint64
+sys_tracectl(void)
+{
+  int on;
+
+  if(argint(0, &on) < 0)
+    return -1;
+  return tracectl(on != 0);
+}
+
+// copy up to n buffered trace events to the user
+// array of struct traceevent at addr.
+uint64
+sys_traceread(void)
+{
+  uint64 addr;
+  int n;
+
+  if(argaddr(0, &addr) < 0 || argint(1, &n) < 0)
+    return -1;
+  return traceread(addr, n);
 }
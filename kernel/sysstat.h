@@ -0,0 +1,11 @@
+// Per-system-call accounting, reported by sysstat().
+// Both the kernel and user programs use this header file.
+
+#define NSYSHIST 32  // log2 latency buckets
+
+struct sysstat {
+  uint64 count;           // number of completed calls
+  uint64 errors;          // calls that returned -1
+  uint64 cycles;          // total latency, in timer cycles
+  uint64 hist[NSYSHIST];  // hist[i] counts calls that took [2^i, 2^(i+1)) cycles; hist[0] from 0
+};
@@ -0,0 +1,202 @@
+//
+// tmpfs: a file system that lives entirely in memory.
+//
+// Inodes are entries in a fixed table, and file contents
+// are kalloc'd pages reached through a per-inode index
+// page, so nothing ever touches the log or the disk.
+// It plugs into the generic inode layer in fs.c through
+// fssw[TMPDEV]; directories use the ordinary dirent format,
+// read and written with readi()/writei().  Everything is
+// lost at reboot.
+//
+// The in-memory struct inode's sleep-lock protects a
+// tmpinode's fields and pages; tmpfs.lock protects only
+// inode allocation.
+//
+
+#include "types.h"
+#include "riscv.h"
+#include "defs.h"
+#include "param.h"
+#include "stat.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "fs.h"
+#include "file.h"
+
+#define NTMPINODE 200                    // inodes per tmpfs
+#define NTMPPAGES (PGSIZE/sizeof(char*))  // pages per file
+#define TMPMAXFILE (NTMPPAGES*PGSIZE)
+
+struct tmpinode {
+  short type;     // 0 if free
+  short major;
+  short minor;
+  short nlink;
+  uint size;
+  char **pages;   // index page of data pages, or 0
+};
+
+struct {
+  struct spinlock lock;
+  struct tmpinode inode[NTMPINODE];
+} tmpfs;
+
+static uint
+tmpialloc(uint dev, short type)
+{
+  int inum;
+  struct tmpinode *tp;
+
+  acquire(&tmpfs.lock);
+  for(inum = ROOTINO+1; inum < NTMPINODE; inum++){
+    tp = &tmpfs.inode[inum];
+    if(tp->type == 0){
+      memset(tp, 0, sizeof(*tp));
+      tp->type = type;
+      release(&tmpfs.lock);
+      return inum;
+    }
+  }
+  release(&tmpfs.lock);
+  return 0;
+}
+
+static void
+tmpiload(struct inode *ip)
+{
+  struct tmpinode *tp = &tmpfs.inode[ip->inum];
+
+  ip->type = tp->type;
+  ip->major = tp->major;
+  ip->minor = tp->minor;
+  ip->nlink = tp->nlink;
+  ip->size = tp->size;
+}
+
+static void
+tmpiupdate(struct inode *ip)
+{
+  struct tmpinode *tp = &tmpfs.inode[ip->inum];
+
+  tp->major = ip->major;
+  tp->minor = ip->minor;
+  tp->nlink = ip->nlink;
+  tp->size = ip->size;
+  // a type of 0 frees the inode; tmpialloc() looks at it.
+  acquire(&tmpfs.lock);
+  tp->type = ip->type;
+  release(&tmpfs.lock);
+}
+
+static void
+tmpitrunc(struct inode *ip)
+{
+  struct tmpinode *tp = &tmpfs.inode[ip->inum];
+  int i;
+
+  if(tp->pages){
+    for(i = 0; i < NTMPPAGES; i++)
+      if(tp->pages[i])
+        kfree(tp->pages[i]);
+    kfree((char*)tp->pages);
+    tp->pages = 0;
+  }
+  ip->size = 0;
+  tmpiupdate(ip);
+}
+
+static int
+tmpreadi(struct inode *ip, int user_dst, uint64 dst, uint off, uint n)
+{
+  struct tmpinode *tp = &tmpfs.inode[ip->inum];
+  uint tot, m;
+
+  if(off > ip->size || off + n < off)
+    return 0;
+  if(off + n > ip->size)
+    n = ip->size - off;
+
+  for(tot=0; tot<n; tot+=m, off+=m, dst+=m){
+    m = PGSIZE - off%PGSIZE;
+    if(m > n - tot)
+      m = n - tot;
+    if(either_copyout(user_dst, dst, tp->pages[off/PGSIZE] + off%PGSIZE, m) == -1)
+      break;
+  }
+  return tot;
+}
+
+static int
+tmpwritei(struct inode *ip, int user_src, uint64 src, uint off, uint n)
+{
+  struct tmpinode *tp = &tmpfs.inode[ip->inum];
+  uint tot, m;
+  char **pg;
+
+  if(off > ip->size || off + n < off)
+    return -1;
+  if(off + n > TMPMAXFILE)
+    return -1;
+
+  if(tp->pages == 0){
+    if((tp->pages = (char**)kalloc()) == 0)
+      return -1;
+    memset(tp->pages, 0, PGSIZE);
+  }
+  for(tot=0; tot<n; tot+=m, off+=m, src+=m){
+    pg = &tp->pages[off/PGSIZE];
+    if(*pg == 0){
+      if((*pg = kalloc()) == 0)
+        break;
+      memset(*pg, 0, PGSIZE);
+    }
+    m = PGSIZE - off%PGSIZE;
+    if(m > n - tot)
+      m = n - tot;
+    if(either_copyin(*pg + off%PGSIZE, user_src, src, m) == -1)
+      break;
+  }
+
+  if(off > ip->size){
+    ip->size = off;
+    tmpiupdate(ip);
+  }
+  return tot == n ? n : -1;
+}
+
+static struct fsops tmpops = {
+  tmpialloc,
+  tmpiload,
+  tmpiupdate,
+  tmpitrunc,
+  tmpreadi,
+  tmpwritei,
+};
+
+// create the root directory, containing just "." and "..",
+// both referring to itself; namex() takes care of ".."
+// from the root of a mounted file system.
+void
+tmpfsinit(void)
+{
+  struct tmpinode *root = &tmpfs.inode[ROOTINO];
+  struct dirent *de;
+
+  initlock(&tmpfs.lock, "tmpfs");
+  root->type = T_DIR;
+  root->nlink = 1;
+  root->size = 2*sizeof(struct dirent);
+  if((root->pages = (char**)kalloc()) == 0)
+    panic("tmpfsinit");
+  memset(root->pages, 0, PGSIZE);
+  if((root->pages[0] = kalloc()) == 0)
+    panic("tmpfsinit");
+  memset(root->pages[0], 0, PGSIZE);
+  de = (struct dirent*)root->pages[0];
+  de[0].inum = ROOTINO;
+  strncpy(de[0].name, ".", DIRSIZ);
+  de[1].inum = ROOTINO;
+  strncpy(de[1].name, "..", DIRSIZ);
+  fssw[TMPDEV] = &tmpops;
+}
@@ -0,0 +1,137 @@
+//
+// Kernel event tracing.
+//
+// ktrace() appends a fixed-size binary record to a buffer
+// owned by the current CPU, with interrupts off and without
+// taking any lock, so tracepoints are cheap enough to leave
+// in hot paths and barely perturb the timing they measure.
+// Each per-CPU buffer is a single-producer ring; readers
+// (the traceread() system call) serialize on tracelock and
+// only ever advance the tail.  A full ring drops new events
+// and counts them, rather than overwriting unread ones.
+//
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "trace.h"
+#include "defs.h"
+
+#define TRACEBATCH 16  // events traceread() copies out at a time
+
+struct tracebuf {
+  struct traceevent ev[NTRACE];
+  uint head;     // next slot to fill; advanced only by the owning CPU
+  uint tail;     // next slot to read; advanced only by readers
+  uint dropped;  // events lost since the last read
+};
+
+static struct tracebuf tracebufs[NCPU];
+static struct spinlock tracelock;
+volatile int tracing;
+
+void
+traceinit(void)
+{
+  initlock(&tracelock, "trace");
+}
+
+// record an event of the given type on this CPU.
+void
+ktrace(int type, uint64 a0, uint64 a1)
+{
+  struct tracebuf *tb;
+  struct traceevent *e;
+  struct proc *p;
+
+  if(!tracing)
+    return;
+
+  push_off();
+  tb = &tracebufs[cpuid()];
+  if(tb->head - tb->tail >= NTRACE){
+    __sync_fetch_and_add(&tb->dropped, 1);
+    pop_off();
+    return;
+  }
+  e = &tb->ev[tb->head % NTRACE];
+  e->time = r_time();
+  e->type = type;
+  e->cpu = cpuid();
+  p = mycpu()->proc;
+  e->pid = p ? p->pid : 0;
+  e->a0 = a0;
+  e->a1 = a1;
+  // publish the record before the head that covers it.
+  __sync_synchronize();
+  tb->head++;
+  pop_off();
+}
+
+// turn tracing on or off; returns the previous setting.
+int
+tracectl(int on)
+{
+  int old = tracing;
+  tracing = on;
+  return old;
+}
+
+// move up to n buffered events into ev[], one CPU's
+// buffer after another.  caller holds tracelock.
+static int
+tracetake(struct traceevent *ev, int n)
+{
+  struct tracebuf *tb;
+  int c, i;
+
+  i = 0;
+  for(c = 0; c < NCPU && i < n; c++){
+    tb = &tracebufs[c];
+    if(tb->dropped){
+      memset(&ev[i], 0, sizeof(ev[i]));
+      ev[i].type = TR_LOST;
+      ev[i].cpu = c;
+      ev[i].time = r_time();
+      ev[i].a0 = __sync_lock_test_and_set(&tb->dropped, 0);
+      i++;
+    }
+    while(i < n && tb->tail != tb->head){
+      // don't read a record until its head update is visible.
+      __sync_synchronize();
+      ev[i++] = tb->ev[tb->tail % NTRACE];
+      // finish reading the record before giving its slot back.
+      __sync_synchronize();
+      tb->tail++;
+    }
+  }
+  return i;
+}
+
+// copy up to n buffered events to the user address dst,
+// each CPU's events in time order.  events are gathered
+// a batch at a time under tracelock, and copied out
+// after releasing it, since copyout() may fault.
+// returns the number of events copied, or -1.
+int
+traceread(uint64 dst, int n)
+{
+  struct proc *p = myproc();
+  struct traceevent batch[TRACEBATCH];
+  int i, m;
+
+  for(i = 0; i < n; i += m){
+    m = n - i < TRACEBATCH ? n - i : TRACEBATCH;
+    acquire(&tracelock);
+    m = tracetake(batch, m);
+    release(&tracelock);
+    if(m == 0)
+      break;
+    if(copyout(p->pagetable, dst + i*sizeof(batch[0]), (char *)batch, m*sizeof(batch[0])) < 0)
+      return -1;
+  }
+  return i;
+}
@@ -0,0 +1,29 @@
+// Kernel trace events, recorded by ktrace() into per-CPU
+// buffers and read by the traceread() system call.
+// Both the kernel and user programs use this header file.
+
+#define NTRACE 512  // events per CPU; a power of two
+
+#define TR_LOST      1   // a0 = events dropped because a buffer was full
+#define TR_SCHED     2   // a0 = pid switched to
+#define TR_SLEEP     3   // a0 = chan
+#define TR_WAKEUP    4   // a0 = chan, a1 = pid woken
+#define TR_BREAD     5   // a0 = blockno, a1 = 1 if cache hit
+#define TR_BWRITE    6   // a0 = blockno
+#define TR_BEGINOP   7   // a0 = outstanding FS system calls
+#define TR_ENDOP     8   // a0 = 1 if this end_op() commits
+#define TR_COMMIT    9   // a0 = blocks written by the commit
+#define TR_DISKSUB  10   // a0 = blockno, a1 = 1 if write
+#define TR_DISKDONE 11   // a0 = blockno
+#define TR_PGFAULT  12   // a0 = faulting address, a1 = scause
+#define TR_SYSCALL  13   // a0 = system call number
+#define TR_SYSRET   14   // a0 = system call number, a1 = return value
+
+struct traceevent {
+  uint64 time;   // time CSR when the event was recorded
+  ushort type;   // TR_*
+  ushort cpu;    // CPU that recorded the event
+  int pid;       // process running on that CPU, or 0
+  uint64 a0;
+  uint64 a1;
+};
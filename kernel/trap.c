@@ -4,11 +4,24 @@
 #include "riscv.h"
 #include "spinlock.h"
 #include "proc.h"
+#include "trace.h"
+#include "clock.h"
 #include "defs.h"
 
 struct spinlock tickslock;
 uint ticks;
 
+// there is no periodic clock interrupt.  each CPU asks for
+// a timer interrupt when its process's quantum is up, or
+// when the earliest timed sleeper's deadline (nextwake)
+// comes, and for none at all when idle with no sleepers.
+struct spinlock timerlock;
+static uint64 nextwake = -1;
+static uint64 boottime;
+
+// mapped read-only into every process, at CLOCKPAGE.
+struct clockpage *clockpage;
+
 extern char trampoline[], uservec[], userret[];
 
 // in kernelvec.S, calls kerneltrap().
@@ -20,6 +33,14 @@ void
 trapinit(void)
 {
   initlock(&tickslock, "time");
+  initlock(&timerlock, "timer");
+  boottime = r_time();
+
+  if((clockpage = (struct clockpage*)kalloc()) == 0)
+    panic("trapinit: clock page");
+  memset(clockpage, 0, PGSIZE);
+  clockpage->freq = CLINT_FREQ;
+  clockpage->boottime = boottime;
 }
 
 // set up to take exceptions and traps while in the kernel.
@@ -27,6 +48,9 @@ void
 trapinithart(void)
 {
   w_stvec((uint64)kernelvec);
+
+  // let user code read the time CSR, for the clock page.
+  w_scounteren(r_scounteren() | 2);
 }
 
 //
@@ -45,6 +69,10 @@ usertrap(void)
   // since we're now in the kernel.
   w_stvec((uint64)kernelvec);
 
+  // usertrapret() keeps SUM as it was; make sure the kernel
+  // can't touch user pages except inside copyin()/copyout().
+  w_sstatus(r_sstatus() & ~SSTATUS_SUM);
+
   struct proc *p = myproc();
   
   // save user program counter.
@@ -68,6 +96,8 @@ usertrap(void)
   } else if((which_dev = devintr()) != 0){
     // ok
   } else {
+    if(r_scause() == 12 || r_scause() == 13 || r_scause() == 15)
+      ktrace(TR_PGFAULT, r_stval(), r_scause());
     printf("usertrap(): unexpected scause %p pid=%d\n", r_scause(), p->pid);
     printf("            sepc=%p stval=%p\n", r_sepc(), r_stval());
     p->killed = 1;
@@ -80,6 +110,12 @@ usertrap(void)
   if(which_dev == 2)
     yield();
 
+  // run any batched system calls the process has queued.
+  if(p->ringpoll){
+    intr_on();
+    ringdrain();
+  }
+
   usertrapret();
 }
 
@@ -119,7 +155,7 @@ usertrapret(void)
   w_sepc(p->trapframe->epc);
 
   // tell trampoline.S the user page table to switch to.
-  uint64 satp = MAKE_SATP(p->pagetable);
+  uint64 satp = MAKE_SATP_ASID(p->pagetable, p->asid);
 
   // jump to trampoline.S at the top of memory, which 
   // switches to the user page table, restores user registers,
@@ -159,19 +195,118 @@ kerneltrap()
   w_sstatus(sstatus);
 }
 
+// clock ticks since boot.
+uint
+tickcount(void)
+{
+  return (r_time() - boottime) / TICKCYCLES;
+}
+
+// requests to timervec in kernelvec.S, which runs in
+// machine mode, and so can program the CLINT.
+#define MCALL_TIMER 0  // timer interrupt at time arg
+#define MCALL_IPI   1  // software interrupt to CPU arg
+
+static void
+mcall(uint64 which, uint64 arg)
+{
+  register uint64 a0 asm("a0") = arg;
+  register uint64 a7 asm("a7") = which;
+
+  asm volatile("ecall" : "+r" (a0) : "r" (a7) : "memory");
+}
+
+// ask for a timer interrupt on this CPU at time when,
+// in place of any earlier request.
+static void
+timerset(uint64 when)
+{
+  mcall(MCALL_TIMER, when);
+}
+
+// interrupt CPU cpu, which will take it as a timer
+// interrupt that found nothing due.
 void
+ipi(int cpu)
+{
+  mcall(MCALL_IPI, cpu);
+}
+
+// ask for this CPU's next timer interrupt: at the end of
+// the quantum if it is running a process, or earlier if
+// a sleeper's deadline comes first.  interrupts are off.
+void
+timerarm(void)
+{
+  struct cpu *c = mycpu();
+  uint64 when;
+
+  acquire(&timerlock);
+  when = nextwake;
+  release(&timerlock);
+  if(c->proc && c->quantumend < when)
+    when = c->quantumend;
+  if(when != c->timerat){
+    c->timerat = when;
+    timerset(when);
+  }
+}
+
+// a caller of sleep(&ticks) wants to be woken at time
+// when, at the latest.  it must recheck the time, and
+// call again, when woken.  interrupts are off.
+void
+timerwait(uint64 when)
+{
+  struct cpu *c = mycpu();
+
+  acquire(&timerlock);
+  if(when < nextwake)
+    nextwake = when;
+  release(&timerlock);
+  if(when < c->timerat){
+    c->timerat = when;
+    timerset(when);
+  }
+}
+
+// a timer interrupt, or an IPI.  wake the timed sleepers
+// if their time has come, and ask for the next interrupt.
+// returns 1 if the running process's quantum is up.
+int
 clockintr()
 {
-  acquire(&tickslock);
-  ticks++;
-  wakeup(&ticks);
-  release(&tickslock);
+  struct cpu *c = mycpu();
+  uint64 now;
+  int due, expired;
+
+  now = r_time();
+  if(now >= c->timerat)
+    c->timerat = -1;  // timervec turned the timer off
+
+  acquire(&timerlock);
+  due = now >= nextwake;
+  if(due)
+    nextwake = -1;  // the sleepers still waiting will say again
+  release(&timerlock);
+  if(due){
+    acquire(&tickslock);
+    ticks = tickcount();
+    wakeup(&ticks);
+    release(&tickslock);
+  }
+
+  expired = c->proc != 0 && now >= c->quantumend;
+  if(expired)
+    c->quantumend = -1;  // until the scheduler starts another
+  timerarm();
+  return expired;
 }
 
 // check if it's an external interrupt or software interrupt,
 // and handle it.
-// returns 2 if timer interrupt,
-// 1 if other device,
+// returns 2 if timer interrupt ending the running
+// process's quantum, 1 if other device or timer,
 // 0 if not recognized.
 int
 devintr()
@@ -204,15 +339,12 @@ devintr()
     // software interrupt from a machine-mode timer interrupt,
     // forwarded by timervec in kernelvec.S.
 
-    if(cpuid() == 0){
-      clockintr();
-    }
-    
     // acknowledge the software interrupt by clearing
-    // the SSIP bit in sip.
+    // the SSIP bit in sip, before clockintr() asks for
+    // the next one, which may already be due.
     w_sip(r_sip() & ~2);
 
-    return 2;
+    return clockintr() ? 2 : 1;
   } else {
     return 0;
   }
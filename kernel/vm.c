@@ -3,6 +3,8 @@
 #include "memlayout.h"
 #include "elf.h"
 #include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
 #include "defs.h"
 #include "fs.h"
 
@@ -15,8 +17,20 @@ extern char etext[];  // kernel.ld sets this to end of kernel code.
 
 extern char trampoline[]; // trampoline.S
 
+static int split(pte_t*);
+
+// bumped whenever a user mapping is removed or loses PTE_U,
+// invalidating every process's copyin/copyout translation cache.
+static uint64 vmgen;
+
 /*
  * create a direct-map page table for the kernel.
+ *
+ * mappings at addresses that no user page table uses
+ * for anything else are PTE_G, so their TLB entries
+ * survive switches between address spaces.  not so the
+ * CLINT, below MAXUVA, nor the kernel stacks, where user
+ * page tables have the trapframe and ring.
  */
 void
 kvminit()
@@ -25,26 +39,27 @@ kvminit()
   memset(kernel_pagetable, 0, PGSIZE);
 
   // uart registers
-  kvmmap(UART0, UART0, PGSIZE, PTE_R | PTE_W);
+  kvmmap(UART0, UART0, PGSIZE, PTE_R | PTE_W | PTE_G);
 
   // virtio mmio disk interface
-  kvmmap(VIRTIO0, VIRTIO0, PGSIZE, PTE_R | PTE_W);
+  kvmmap(VIRTIO0, VIRTIO0, PGSIZE, PTE_R | PTE_W | PTE_G);
 
   // CLINT
   kvmmap(CLINT, CLINT, 0x10000, PTE_R | PTE_W);
 
   // PLIC
-  kvmmap(PLIC, PLIC, 0x400000, PTE_R | PTE_W);
+  kvmmap(PLIC, PLIC, 0x400000, PTE_R | PTE_W | PTE_G);
 
   // map kernel text executable and read-only.
-  kvmmap(KERNBASE, KERNBASE, (uint64)etext-KERNBASE, PTE_R | PTE_X);
+  kvmmap(KERNBASE, KERNBASE, (uint64)etext-KERNBASE, PTE_R | PTE_X | PTE_G);
 
   // map kernel data and the physical RAM we'll make use of.
-  kvmmap((uint64)etext, (uint64)etext, PHYSTOP-(uint64)etext, PTE_R | PTE_W);
+  // mappages() uses megapages from the first 2 MB boundary on.
+  kvmmap((uint64)etext, (uint64)etext, PHYSTOP-(uint64)etext, PTE_R | PTE_W | PTE_G);
 
   // map the trampoline for trap entry/exit to
   // the highest virtual address in the kernel.
-  kvmmap(TRAMPOLINE, (uint64)trampoline, PGSIZE, PTE_R | PTE_X);
+  kvmmap(TRAMPOLINE, (uint64)trampoline, PGSIZE, PTE_R | PTE_X | PTE_G);
 }
 
 // Switch h/w page table register to the kernel's page table,
@@ -58,7 +73,9 @@ kvminithart()
 
 // Return the address of the PTE in page table pagetable
 // that corresponds to virtual address va.  If alloc!=0,
-// create any required page-table pages.
+// create any required page-table pages, and split a
+// megapage in the way into 4096-byte pages.  If alloc==0,
+// a megapage in the way makes walk() return 0.
 //
 // The risc-v Sv39 scheme has three levels of page-table
 // pages. A page-table page contains 512 64-bit PTEs.
@@ -76,6 +93,10 @@ walk(pagetable_t pagetable, uint64 va, int alloc)
 
   for(int level = 2; level > 0; level--) {
     pte_t *pte = &pagetable[PX(level, va)];
+    if((*pte & PTE_V) && PTE_LEAF(*pte)) {
+      if(!alloc || level != 1 || split(pte) < 0)
+        return 0;
+    }
     if(*pte & PTE_V) {
       pagetable = (pagetable_t)PTE2PA(*pte);
     } else {
@@ -88,26 +109,91 @@ walk(pagetable_t pagetable, uint64 va, int alloc)
   return &pagetable[PX(0, va)];
 }
 
-// Look up a virtual address, return the physical address,
-// or 0 if not mapped.
+// Replace the megapage leaf *pte with a pointer to a new
+// page-table page of 512 leaves mapping the same memory with
+// the same permissions.  Returns -1 if out of memory.
+static int
+split(pte_t *pte)
+{
+  pagetable_t pagetable;
+  uint64 pa, flags;
+  int i;
+
+  if((pagetable = (pagetable_t)kalloc()) == 0)
+    return -1;
+  pa = PTE2PA(*pte);
+  flags = PTE_FLAGS(*pte);
+  for(i = 0; i < 512; i++)
+    pagetable[i] = PA2PTE(pa + i*PGSIZE) | flags;
+  *pte = PA2PTE(pagetable) | PTE_V;
+  return 0;
+}
+
+// Like walk(), but never allocates or splits: returns the
+// leaf PTE that maps va, be it for a page or a megapage,
+// and sets *size to the number of bytes it maps.  Returns
+// 0 if a level above the last has no page-table page.
+static pte_t *
+walkleaf(pagetable_t pagetable, uint64 va, uint64 *size)
+{
+  pte_t *pte;
+  int level;
+
+  if(va >= MAXVA)
+    panic("walkleaf");
+
+  for(level = 2; level > 0; level--){
+    pte = &pagetable[PX(level, va)];
+    if((*pte & PTE_V) == 0)
+      return 0;
+    if(PTE_LEAF(*pte)){
+      *size = 1L << PXSHIFT(level);
+      return pte;
+    }
+    pagetable = (pagetable_t)PTE2PA(*pte);
+  }
+  *size = PGSIZE;
+  return &pagetable[PX(0, va)];
+}
+
+// If va falls inside, but not at the start of, a megapage
+// in pagetable, split the megapage so that the mappings on
+// either side of va can be changed separately.
+// Returns -1 if out of memory, in which case nothing changed.
+static int
+uvmsplit(pagetable_t pagetable, uint64 va)
+{
+  pte_t *pte;
+  uint64 size;
+
+  if(va >= MAXVA)
+    return 0;
+  pte = walkleaf(pagetable, va, &size);
+  if(pte == 0 || (*pte & PTE_V) == 0 || size != MEGASIZE || va % size == 0)
+    return 0;
+  return split(pte);
+}
+
+// Look up a virtual address, return the physical address
+// of its page, or 0 if not mapped.
 // Can only be used to look up user pages.
 uint64
 walkaddr(pagetable_t pagetable, uint64 va)
 {
   pte_t *pte;
-  uint64 pa;
+  uint64 pa, size;
 
   if(va >= MAXVA)
     return 0;
 
-  pte = walk(pagetable, va, 0);
+  pte = walkleaf(pagetable, va, &size);
   if(pte == 0)
     return 0;
   if((*pte & PTE_V) == 0)
     return 0;
   if((*pte & PTE_U) == 0)
     return 0;
-  pa = PTE2PA(*pte);
+  pa = PTE2PA(*pte) + (PGROUNDDOWN(va) & (size - 1));
   return pa;
 }
 
@@ -128,22 +214,225 @@ kvmmap(uint64 va, uint64 pa, uint64 sz, int perm)
 uint64
 kvmpa(uint64 va)
 {
-  uint64 off = va % PGSIZE;
   pte_t *pte;
-  uint64 pa;
+  uint64 pa, size;
   
-  pte = walk(kernel_pagetable, va, 0);
+  pte = walkleaf(kernel_pagetable, va, &size);
   if(pte == 0)
     panic("kvmpa");
   if((*pte & PTE_V) == 0)
     panic("kvmpa");
   pa = PTE2PA(*pte);
-  return pa+off;
+  return pa + (va & (size - 1));
+}
+
+// Create a process's kernel page table: the kernel's
+// mappings, sharing its page-table pages, except that the
+// first 1 GB gets a level-1 page of its own, so that
+// kvmsync() can map the process's memory below MAXUVA.
+// Returns 0 if out of memory.
+pagetable_t
+kvmcreate(void)
+{
+  pagetable_t kpt, l1, kl1;
+  int i;
+
+  if((kpt = (pagetable_t) kalloc()) == 0)
+    return 0;
+  if((l1 = (pagetable_t) kalloc()) == 0){
+    kfree(kpt);
+    return 0;
+  }
+  memmove(kpt, kernel_pagetable, PGSIZE);
+  memset(l1, 0, PGSIZE);
+  kl1 = (pagetable_t) PTE2PA(kernel_pagetable[0]);
+  for(i = PX(1, MAXUVA); i < 512; i++)
+    l1[i] = kl1[i];
+  kpt[0] = PA2PTE(l1) | PTE_V;
+  return kpt;
+}
+
+// Free a page table made by kvmcreate().  The pages
+// below it belong to the kernel or to the user page table.
+void
+kvmfree(pagetable_t kpt)
+{
+  kfree((void*)PTE2PA(kpt[0]));
+  kfree(kpt);
+}
+
+// Point p's kernel page table at the same memory below
+// MAXUVA as p->pagetable, by copying its level-1 PTEs:
+// the two then share the user's level-0 page-table pages,
+// so only changes at level 1 (page-table pages allocated
+// or freed, megapages mapped or split) need another call.
+// Call after changing p->pagetable or its user memory.
+void
+kvmsync(struct proc *p)
+{
+  pagetable_t kl1, ul1;
+  int i;
+
+  kl1 = (pagetable_t) PTE2PA(p->kpagetable[0]);
+  ul1 = 0;
+  if(p->pagetable[0] & PTE_V)
+    ul1 = (pagetable_t) PTE2PA(p->pagetable[0]);
+  for(i = 0; i < PX(1, MAXUVA); i++)
+    kl1[i] = ul1 ? ul1[i] : 0;
+  if(p == myproc())
+    uvmflush(p);
+}
+
+// Address-space IDs.  Each process has two, for its user
+// and kernel page tables; ASID 0 is kernel_pagetable's.
+// They are handed out in order and not reused within a
+// generation: when they run out, a new generation starts,
+// and each CPU flushes its whole TLB before it next uses
+// an ASID, after which old-generation entries are gone.
+// Processes holding old-generation ASIDs get new ones
+// when next scheduled.  With no (or too few) ASIDs in the
+// hardware, every process uses ASID 0, and switching page
+// tables flushes the TLB, as trampoline.S does for ASID 0.
+struct {
+  struct spinlock lock;
+  uint64 gen;
+  int next;
+  int max;    // the hardware's number of ASIDs, or 0
+} asids;
+
+void
+asidinit(void)
+{
+  uint64 satp;
+
+  initlock(&asids.lock, "asid");
+  // the ASID bits the hardware lacks read back as zero.
+  satp = r_satp();
+  w_satp(satp | SATP_ASIDMASK);
+  asids.max = ((r_satp() & SATP_ASIDMASK) >> SATP_ASIDSHIFT) + 1;
+  w_satp(satp);
+  sfence_vma();
+  if(asids.max < 16)
+    asids.max = 0;
+  asids.gen = 1;
+  asids.next = 1;
+}
+
+// Switch this CPU to p's kernel page table, first giving
+// p ASIDs of the current generation if it lacks them, or
+// back to kernel_pagetable if p is 0.  Called by the
+// scheduler, with p->lock held.
+void
+kvmswitch(struct proc *p)
+{
+  struct cpu *c = mycpu();
+  int flushall, fresh;
+
+  if(p == 0){
+    w_satp(MAKE_SATP(kernel_pagetable));
+    if(asids.max == 0)
+      sfence_vma();
+    return;
+  }
+
+  flushall = fresh = 0;
+  if(asids.max){
+    acquire(&asids.lock);
+    if(p->asidgen != asids.gen){
+      if(asids.next + 2 > asids.max){
+        asids.gen++;
+        asids.next = 1;
+      }
+      p->asid = asids.next++;
+      p->kasid = asids.next++;
+      p->asidgen = asids.gen;
+      fresh = 1;
+    }
+    if(c->asidgen != asids.gen){
+      c->asidgen = asids.gen;
+      flushall = 1;
+    }
+    release(&asids.lock);
+  }
+
+  w_satp(MAKE_SATP_ASID(p->kpagetable, p->kasid));
+  if(asids.max == 0 || flushall)
+    sfence_vma();
+  else if(!fresh && p->asidcpu != cpuid())
+    uvmflush(p);  // p's page tables may have changed elsewhere
+  p->asidcpu = cpuid();
+}
+
+// Flush this CPU's TLB entries for p's page tables,
+// after changing them.  p's kernel page table shares
+// level-0 pages with its user page table, so both go.
+void
+uvmflush(struct proc *p)
+{
+  if(p->asid == 0){
+    sfence_vma();
+    return;
+  }
+  sfence_vma_asid(p->asid);
+  sfence_vma_asid(p->kasid);
+}
+
+// Flush this CPU's TLB entry for p's user page at va,
+// after changing only its leaf PTE.
+void
+uvmflushpage(struct proc *p, uint64 va)
+{
+  if(p->asid == 0){
+    sfence_vma();
+    return;
+  }
+  sfence_vma_page(va, p->asid);
+  if(va < MAXUVA)
+    sfence_vma_page(va, p->kasid);
+}
+
+// Map the 2 MB at va, which must be 2 MB-aligned, to pa as
+// a single megapage, if the level-1 PTE for va is free for
+// one: invalid, or pointing to a page-table page with no
+// valid PTEs (which is freed).  Returns 0 on success, -1
+// (having mapped nothing) if not.
+static int
+mapmega(pagetable_t pagetable, uint64 va, uint64 pa, int perm)
+{
+  pte_t *pte;
+  pagetable_t pt;
+  int i;
+
+  if(va % MEGASIZE != 0 || pa % MEGASIZE != 0)
+    return -1;
+  pte = &pagetable[PX(2, va)];
+  if(*pte & PTE_V){
+    pagetable = (pagetable_t)PTE2PA(*pte);
+  } else {
+    if((pagetable = (pde_t*)kalloc()) == 0)
+      return -1;
+    memset(pagetable, 0, PGSIZE);
+    *pte = PA2PTE(pagetable) | PTE_V;
+  }
+  pte = &pagetable[PX(1, va)];
+  if(*pte & PTE_V){
+    if(PTE_LEAF(*pte))
+      return -1;
+    pt = (pagetable_t)PTE2PA(*pte);
+    for(i = 0; i < 512; i++)
+      if(pt[i] & PTE_V)
+        return -1;
+    kfree((void*)pt);
+  }
+  *pte = PA2PTE(pa) | perm | PTE_V;
+  return 0;
 }
 
 // Create PTEs for virtual addresses starting at va that refer to
 // physical addresses starting at pa. va and size might not
-// be page-aligned. Returns 0 on success, -1 if walk() couldn't
+// be page-aligned.  Each 2 MB of va and pa that are both
+// aligned to 2 MB is mapped as a megapage if it can be.
+// Returns 0 on success, -1 if walk() couldn't
 // allocate a needed page-table page.
 int
 mappages(pagetable_t pagetable, uint64 va, uint64 size, uint64 pa, int perm)
@@ -154,6 +443,13 @@ mappages(pagetable_t pagetable, uint64 va, uint64 size, uint64 pa, int perm)
   a = PGROUNDDOWN(va);
   last = PGROUNDDOWN(va + size - 1);
   for(;;){
+    if(last - a >= MEGASIZE - PGSIZE && mapmega(pagetable, a, pa, perm) == 0){
+      if(last - a == MEGASIZE - PGSIZE)
+        break;
+      a += MEGASIZE;
+      pa += MEGASIZE;
+      continue;
+    }
     if((pte = walk(pagetable, a, 1)) == 0)
       return -1;
     if(*pte & PTE_V)
@@ -169,29 +465,35 @@ mappages(pagetable_t pagetable, uint64 va, uint64 size, uint64 pa, int perm)
 
 // Remove npages of mappings starting from va. va must be
 // page-aligned. The mappings must exist.
+// A megapage only partly in the range must already have
+// been split with uvmsplit(), so that this can't fail.
 // Optionally free the physical memory.
 void
 uvmunmap(pagetable_t pagetable, uint64 va, uint64 npages, int do_free)
 {
-  uint64 a;
+  uint64 a, end, size;
   pte_t *pte;
 
   if((va % PGSIZE) != 0)
     panic("uvmunmap: not aligned");
 
-  for(a = va; a < va + npages*PGSIZE; a += PGSIZE){
-    if((pte = walk(pagetable, a, 0)) == 0)
+  end = va + npages*PGSIZE;
+  for(a = va; a < end; a += size){
+    if((pte = walkleaf(pagetable, a, &size)) == 0)
       panic("uvmunmap: walk");
     if((*pte & PTE_V) == 0)
       panic("uvmunmap: not mapped");
     if(PTE_FLAGS(*pte) == PTE_V)
       panic("uvmunmap: not a leaf");
+    if(size > PGSIZE && (a % size != 0 || a + size > end))
+      panic("uvmunmap: partial megapage");
     if(do_free){
       uint64 pa = PTE2PA(*pte);
-      kfree((void*)pa);
+      kfreeorder((void*)pa, size == PGSIZE ? 0 : MEGAORDER);
     }
     *pte = 0;
   }
+  __sync_fetch_and_add(&vmgen, 1);
 }
 
 // create an empty user page table.
@@ -225,17 +527,27 @@ uvminit(pagetable_t pagetable, uchar *src, uint sz)
 
 // Allocate PTEs and physical memory to grow process from oldsz to
 // newsz, which need not be page aligned.  Returns new size or 0 on error.
+// Each 2 MB-aligned 2 MB of the new memory is a megapage when
+// the allocator has one to give.
 uint64
 uvmalloc(pagetable_t pagetable, uint64 oldsz, uint64 newsz)
 {
   char *mem;
-  uint64 a;
+  uint64 a, size;
 
   if(newsz < oldsz)
     return oldsz;
 
   oldsz = PGROUNDUP(oldsz);
-  for(a = oldsz; a < newsz; a += PGSIZE){
+  for(a = oldsz; a < newsz; a += size){
+    size = MEGASIZE;
+    if(a % MEGASIZE == 0 && newsz - a >= MEGASIZE && (mem = kallocorder(MEGAORDER)) != 0){
+      memset(mem, 0, MEGASIZE);
+      if(mapmega(pagetable, a, (uint64)mem, PTE_W|PTE_X|PTE_R|PTE_U) == 0)
+        continue;
+      kfreeorder(mem, MEGAORDER);
+    }
+    size = PGSIZE;
     mem = kalloc();
     if(mem == 0){
       uvmdealloc(pagetable, a, oldsz);
@@ -254,16 +566,24 @@ uvmalloc(pagetable_t pagetable, uint64 oldsz, uint64 newsz)
 // Deallocate user pages to bring the process size from oldsz to
 // newsz.  oldsz and newsz need not be page-aligned, nor does newsz
 // need to be less than oldsz.  oldsz can be larger than the actual
-// process size.  Returns the new process size.
+// process size.  Returns the new process size, or oldsz if a
+// megapage straddling an end of the range couldn't be split.
 uint64
 uvmdealloc(pagetable_t pagetable, uint64 oldsz, uint64 newsz)
 {
+  uint64 va, end;
+
   if(newsz >= oldsz)
     return oldsz;
 
-  if(PGROUNDUP(newsz) < PGROUNDUP(oldsz)){
-    int npages = (PGROUNDUP(oldsz) - PGROUNDUP(newsz)) / PGSIZE;
-    uvmunmap(pagetable, PGROUNDUP(newsz), npages, 1);
+  va = PGROUNDUP(newsz);
+  end = PGROUNDUP(oldsz);
+  if(va < end){
+    // split before unmapping anything, so that running
+    // out of memory leaves the old mappings intact.
+    if(uvmsplit(pagetable, va) < 0 || uvmsplit(pagetable, end) < 0)
+      return oldsz;
+    uvmunmap(pagetable, va, (end - va) / PGSIZE, 1);
   }
 
   return newsz;
@@ -309,17 +629,26 @@ int
 uvmcopy(pagetable_t old, pagetable_t new, uint64 sz)
 {
   pte_t *pte;
-  uint64 pa, i;
+  uint64 pa, i, size;
   uint flags;
   char *mem;
 
-  for(i = 0; i < sz; i += PGSIZE){
-    if((pte = walk(old, i, 0)) == 0)
+  for(i = 0; i < sz; i += size){
+    if((pte = walkleaf(old, i, &size)) == 0)
       panic("uvmcopy: pte should exist");
     if((*pte & PTE_V) == 0)
       panic("uvmcopy: page not present");
-    pa = PTE2PA(*pte);
+    pa = PTE2PA(*pte) + (i & (size - 1));
     flags = PTE_FLAGS(*pte);
+    // copy a megapage into a megapage if possible,
+    // else a page at a time.
+    if(size == MEGASIZE && i % MEGASIZE == 0 && (mem = kallocorder(MEGAORDER)) != 0){
+      memmove(mem, (char*)pa, MEGASIZE);
+      if(mapmega(new, i, (uint64)mem, flags) == 0)
+        continue;
+      kfreeorder(mem, MEGAORDER);
+    }
+    size = PGSIZE;
     if((mem = kalloc()) == 0)
       goto err;
     memmove(mem, (char*)pa, PGSIZE);
@@ -346,6 +675,63 @@ uvmclear(pagetable_t pagetable, uint64 va)
   if(pte == 0)
     panic("uvmclear");
   *pte &= ~PTE_U;
+  __sync_fetch_and_add(&vmgen, 1);
+}
+
+// like walkaddr(), but remember the last translation in the
+// current process, so that a run of copyin()/copyout() calls
+// on the same user page walks the page table only once.
+// if write, the page must be writable (unlike the clock page).
+static uint64
+uvmaddr(pagetable_t pagetable, uint64 va0, int write)
+{
+  struct proc *p = myproc();
+  uint64 gen, pa0, size;
+  pte_t *pte;
+
+  gen = vmgen;
+  if(p && p->vmcache.pagetable == pagetable && p->vmcache.va == va0 &&
+     p->vmcache.gen == gen && (p->vmcache.writable || !write))
+    return p->vmcache.pa;
+  if(va0 >= MAXVA)
+    return 0;
+  pte = walkleaf(pagetable, va0, &size);
+  if(pte == 0 || (*pte & (PTE_V|PTE_U)) != (PTE_V|PTE_U))
+    return 0;
+  if(write && (*pte & PTE_W) == 0)
+    return 0;
+  pa0 = PTE2PA(*pte) + (va0 & (size - 1));
+  if(p){
+    p->vmcache.pagetable = pagetable;
+    p->vmcache.va = va0;
+    p->vmcache.pa = pa0;
+    p->vmcache.writable = (*pte & PTE_W) != 0;
+    p->vmcache.gen = gen;
+  }
+  return pa0;
+}
+
+// can [va, va+len) in pagetable be used directly?  yes if
+// it is the current process's memory, which its kernel page
+// table maps as well (see kvmsync()), but not its stack
+// guard page, which the kernel could reach though the user
+// cannot.  the caller sets SSTATUS_SUM around the access,
+// since the pages are PTE_U; scheduler() and usertrap()
+// clear it again if a timer interrupt preempts the copy.
+static int
+uvmdirect(pagetable_t pagetable, uint64 va, uint64 len)
+{
+  struct proc *p = myproc();
+
+  if(p == 0 || pagetable != p->pagetable)
+    return 0;
+  if((r_satp() & ~SATP_ASIDMASK) != MAKE_SATP(p->kpagetable))
+    return 0;
+  if(va + len < va || va + len > p->sz || va + len > MAXUVA)
+    return 0;
+  if(p->guard && va < p->guard + PGSIZE && va + len > p->guard)
+    return 0;
+  return 1;
 }
 
 // Copy from kernel to user.
@@ -356,9 +742,16 @@ copyout(pagetable_t pagetable, uint64 dstva, char *src, uint64 len)
 {
   uint64 n, va0, pa0;
 
+  if(uvmdirect(pagetable, dstva, len)){
+    w_sstatus(r_sstatus() | SSTATUS_SUM);
+    memmove((void *)dstva, src, len);
+    w_sstatus(r_sstatus() & ~SSTATUS_SUM);
+    return 0;
+  }
+
   while(len > 0){
     va0 = PGROUNDDOWN(dstva);
-    pa0 = walkaddr(pagetable, va0);
+    pa0 = uvmaddr(pagetable, va0, 1);
     if(pa0 == 0)
       return -1;
     n = PGSIZE - (dstva - va0);
@@ -381,9 +774,16 @@ copyin(pagetable_t pagetable, char *dst, uint64 srcva, uint64 len)
 {
   uint64 n, va0, pa0;
 
+  if(uvmdirect(pagetable, srcva, len)){
+    w_sstatus(r_sstatus() | SSTATUS_SUM);
+    memmove(dst, (void *)srcva, len);
+    w_sstatus(r_sstatus() & ~SSTATUS_SUM);
+    return 0;
+  }
+
   while(len > 0){
     va0 = PGROUNDDOWN(srcva);
-    pa0 = walkaddr(pagetable, va0);
+    pa0 = uvmaddr(pagetable, va0, 0);
     if(pa0 == 0)
       return -1;
     n = PGSIZE - (srcva - va0);
@@ -405,12 +805,33 @@ copyin(pagetable_t pagetable, char *dst, uint64 srcva, uint64 len)
 int
 copyinstr(pagetable_t pagetable, char *dst, uint64 srcva, uint64 max)
 {
-  uint64 n, va0, pa0;
+  uint64 n, va0, pa0, sz;
   int got_null = 0;
 
+  // directly, if the whole of [srcva, srcva+max) that lies
+  // below p->sz may be; a string running past p->sz is left
+  // to the page-by-page loop.
+  sz = myproc() ? myproc()->sz : 0;
+  n = 0;
+  if(srcva < sz)
+    n = sz - srcva < max ? sz - srcva : max;
+  if(n > 0 && uvmdirect(pagetable, srcva, n)){
+    char *s = (char *) srcva;
+    uint64 i;
+
+    w_sstatus(r_sstatus() | SSTATUS_SUM);
+    for(i = 0; i < n && (dst[i] = s[i]) != '\0'; i++)
+      ;
+    w_sstatus(r_sstatus() & ~SSTATUS_SUM);
+    if(i < n)
+      return 0;
+    if(n == max)
+      return -1;
+  }
+
   while(got_null == 0 && max > 0){
     va0 = PGROUNDDOWN(srcva);
-    pa0 = walkaddr(pagetable, va0);
+    pa0 = uvmaddr(pagetable, va0, 0);
     if(pa0 == 0)
       return -1;
     n = PGSIZE - (srcva - va0);
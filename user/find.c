@@ -2,11 +2,19 @@
 #include "kernel/stat.h"
 #include "user/user.h"
 #include "kernel/fs.h"
+#include "kernel/fcntl.h"
+
+// entries per getdents(); each level of recursion has its own
+// batch on the (small) user stack, so keep it modest.
+#define NENT 8
+
+// the path being searched; each level appends to its parent's.
+static char buf[512];
 
 void find(char *src, char *dst) {
-    char buf[512], *p;
-    int fd;
-    struct dirent de;
+    char *p;
+    int fd, i, n;
+    struct dentry ents[NENT];
     struct stat st;
 
     if ((fd = open(src, 0)) < 0) {
@@ -29,26 +37,19 @@ void find(char *src, char *dst) {
         fprintf(2, "find: path too long\n");
         return;
     }
-    strcpy(buf, src);
+    if (src != buf) strcpy(buf, src);
     p = buf + strlen(buf);
     *p++ = '/';
 
-    while (read(fd, &de, sizeof(de)) == sizeof(de)) {
-        if (de.inum == 0) continue;
-
-        memmove(p, de.name, DIRSIZ);
-
-        p[DIRSIZ] = 0;
-
-        if (stat(buf, &st) < 0) {
-            fprintf(2, "find: cannot stat %s\n", buf);
-            continue;
-        }
+    while ((n = getdents(fd, ents, NENT, GD_STAT)) > 0) {
+        for (i = 0; i < n; i++) {
+            strcpy(p, ents[i].name);
 
-        if (st.type == T_DIR && strcmp(p, ".") != 0 && strcmp(p, "..") != 0) {
-            find(buf, dst);
-        } else if (strcmp(dst, p) == 0) {
-            printf("%s\n", buf);
+            if (ents[i].type == T_DIR && strcmp(p, ".") != 0 && strcmp(p, "..") != 0) {
+                find(buf, dst);
+            } else if (strcmp(dst, p) == 0) {
+                printf("%s\n", buf);
+            }
         }
     }
     close(fd);
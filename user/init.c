@@ -23,6 +23,11 @@ main(void)
   dup(0);  // stdout
   dup(0);  // stderr
 
+  // scratch files in /tmp stay in memory.
+  mkdir("/tmp");
+  if(mount("/tmp", "tmpfs") < 0)
+    printf("init: mount /tmp failed\n");
+
   for(;;){
     printf("init: starting sh\n");
     pid = fork();
@@ -0,0 +1,101 @@
+// ktrace: run a command with kernel event tracing on,
+// then print the recorded events in time order.
+//
+//   ktrace cmd [args...]
+//
+// times are microseconds since the first event, assuming
+// qemu's 10 MHz timebase.
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "kernel/trace.h"
+#include "user/user.h"
+
+#define MAXEV  (NCPU*NTRACE)
+
+static char *names[] = {
+[TR_LOST]     "lost",
+[TR_SCHED]    "sched",
+[TR_SLEEP]    "sleep",
+[TR_WAKEUP]   "wakeup",
+[TR_BREAD]    "bread",
+[TR_BWRITE]   "bwrite",
+[TR_BEGINOP]  "begin_op",
+[TR_ENDOP]    "end_op",
+[TR_COMMIT]   "commit",
+[TR_DISKSUB]  "disk_sub",
+[TR_DISKDONE] "disk_done",
+[TR_PGFAULT]  "pgfault",
+[TR_SYSCALL]  "syscall",
+[TR_SYSRET]   "sysret",
+};
+
+static struct traceevent ev[MAXEV];
+
+// traceread() hands back each CPU's events in order,
+// one CPU after another; sort the lot by time.
+// insertion sort keeps nearly-sorted runs cheap.
+static void
+sort(int n)
+{
+  struct traceevent t;
+  int i, j;
+
+  for(i = 1; i < n; i++){
+    t = ev[i];
+    for(j = i; j > 0 && ev[j-1].time > t.time; j--)
+      ev[j] = ev[j-1];
+    ev[j] = t;
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  int i, n, m, pid;
+  uint64 t0;
+  char *name;
+
+  if(argc < 2){
+    fprintf(2, "usage: ktrace cmd [args...]\n");
+    exit(1);
+  }
+
+  // discard anything left over from an earlier run.
+  tracectl(0);
+  while(traceread(ev, MAXEV) > 0)
+    ;
+
+  tracectl(1);
+  pid = fork();
+  if(pid < 0){
+    tracectl(0);
+    fprintf(2, "ktrace: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    exec(argv[1], argv+1);
+    fprintf(2, "ktrace: exec %s failed\n", argv[1]);
+    exit(1);
+  }
+  wait(0);
+  tracectl(0);
+
+  n = 0;
+  while(n < MAXEV && (m = traceread(ev+n, MAXEV-n)) > 0)
+    n += m;
+  if(n == 0)
+    exit(0);
+  sort(n);
+
+  t0 = ev[0].time;
+  for(i = 0; i < n; i++){
+    if(ev[i].type < sizeof(names)/sizeof(names[0]) && names[ev[i].type])
+      name = names[ev[i].type];
+    else
+      name = "?";
+    printf("%d cpu%d pid %d %s %p %p\n", (int)((ev[i].time - t0) / 10),
+           ev[i].cpu, ev[i].pid, name, ev[i].a0, ev[i].a1);
+  }
+  exit(0);
+}
@@ -2,6 +2,11 @@
 #include "kernel/stat.h"
 #include "user/user.h"
 #include "kernel/fs.h"
+#include "kernel/fcntl.h"
+
+#define NENT 32
+
+static struct dentry ents[NENT];
 
 char *fmtname(char *path) {
     static char buf[DIRSIZ + 1];
@@ -20,9 +25,7 @@ char *fmtname(char *path) {
 }
 
 void ls(char *path) {
-    char buf[512], *p;
-    int fd;
-    struct dirent de;
+    int fd, i, n;
     struct stat st;
 
     if ((fd = open(path, 0)) < 0) {
@@ -42,23 +45,13 @@ void ls(char *path) {
             break;
 
         case T_DIR:
-            if (strlen(path) + 1 + DIRSIZ + 1 > sizeof buf) {
-                printf("ls: path too long\n");
-                break;
-            }
-            strcpy(buf, path);
-            p = buf + strlen(buf);
-            *p++ = '/';
-            while (read(fd, &de, sizeof(de)) == sizeof(de)) {
-                if (de.inum == 0) continue;
-                memmove(p, de.name, DIRSIZ);
-                p[DIRSIZ] = 0;
-                if (stat(buf, &st) < 0) {
-                    printf("ls: cannot stat %s\n", buf);
-                    continue;
-                }
-                printf("%s %d %d %d\n", fmtname(buf), st.type, st.ino, st.size);
+            // one getdents() per NENT entries, types and sizes included.
+            while ((n = getdents(fd, ents, NENT, GD_STAT)) > 0) {
+                for (i = 0; i < n; i++)
+                    printf("%s %d %d %d\n", fmtname(ents[i].name), ents[i].type, ents[i].inum,
+                           (int)ents[i].size);
             }
+            if (n < 0) printf("ls: cannot read %s\n", path);
             break;
     }
     close(fd);
@@ -0,0 +1,101 @@
+// membench: time the library's memset, memmove and memcmp
+// against the byte-at-a-time loops they replaced.
+//
+//   membench [iterations]
+//
+// times are in clock ticks, for iterations calls on a page.
+
+#include "kernel/types.h"
+#include "kernel/riscv.h"
+#include "user/user.h"
+
+static char a[PGSIZE+64], b[PGSIZE+64];
+
+static void*
+oldmemset(void *dst, int c, uint n)
+{
+  char *cdst = (char *) dst;
+  int i;
+  for(i = 0; i < n; i++){
+    cdst[i] = c;
+  }
+  return dst;
+}
+
+static void*
+oldmemmove(void *vdst, const void *vsrc, int n)
+{
+  char *dst;
+  const char *src;
+
+  dst = vdst;
+  src = vsrc;
+  if (src > dst) {
+    while(n-- > 0)
+      *dst++ = *src++;
+  } else {
+    dst += n;
+    src += n;
+    while(n-- > 0)
+      *--dst = *--src;
+  }
+  return vdst;
+}
+
+static int
+oldmemcmp(const void *s1, const void *s2, uint n)
+{
+  const char *p1 = s1, *p2 = s2;
+  while (n-- > 0) {
+    if (*p1 != *p2) {
+      return *p1 - *p2;
+    }
+    p1++;
+    p2++;
+  }
+  return 0;
+}
+
+#define SET  0
+#define MOVE 1
+#define CMP  2
+
+// run iterations calls of op (the old version if old)
+// with dst and src offset from page alignment by off.
+static int
+run(int op, int old, int off, int iterations)
+{
+  int i, t0;
+
+  t0 = uptime();
+  for(i = 0; i < iterations; i++){
+    if(op == SET)
+      old ? oldmemset(a + off, i, PGSIZE) : memset(a + off, i, PGSIZE);
+    else if(op == MOVE)
+      old ? oldmemmove(a + off, b, PGSIZE) : memmove(a + off, b, PGSIZE);
+    else if(old ? oldmemcmp(a + off, b + off, PGSIZE) : memcmp(a + off, b + off, PGSIZE))
+      printf("membench: memcmp mismatch\n");
+  }
+  return uptime() - t0;
+}
+
+int
+main(int argc, char *argv[])
+{
+  static char *names[] = { "memset", "memmove", "memcmp" };
+  int op, off, n, told, tnew;
+
+  n = argc > 1 ? atoi(argv[1]) : 20000;
+  printf("%d page-sized calls, in ticks\n", n);
+  printf("op       offset  old     new\n");
+  for(op = SET; op <= CMP; op++){
+    for(off = 0; off < 8; off += 3){
+      memset(a, 0, sizeof(a));
+      memset(b, 0, sizeof(b));
+      told = run(op, 1, off, n);
+      tnew = run(op, 0, off, n);
+      printf("%s\t %d\t %d\t %d\n", names[op], off, told, tnew);
+    }
+  }
+  exit(0);
+}
@@ -1,4 +1,5 @@
 #include "kernel/types.h"
+#include "kernel/param.h"
 #include "kernel/stat.h"
 #include "user/user.h"
 
@@ -6,10 +7,75 @@
 
 static char digits[] = "0123456789ABCDEF";
 
+// output to each fd is collected in a buffer and written
+// with one write() system call, when the buffer fills, at
+// each newline for devices (the console), and at the end of
+// each printf for fd 2.  ulib.c's fork(), exec(), exit()
+// and close() flush through outflush.
+#define OBUFSIZE 512
+
+#define OB_NONE 1  // flushed at the end of each printf
+#define OB_LINE 2  // flushed at each newline
+#define OB_FULL 3  // flushed when full
+
+static struct {
+  int mode;  // 0 until the fd's first output
+  int n;
+  char buf[OBUFSIZE];
+} obuf[NOFILE];
+
+extern void (*outflush)(int);
+
+void
+fflush(int fd)
+{
+  if(fd < 0 || fd >= NOFILE || obuf[fd].n == 0)
+    return;
+  write(fd, obuf[fd].buf, obuf[fd].n);
+  obuf[fd].n = 0;
+}
+
+// flush every fd (fd < 0), or flush fd and forget
+// its mode since it is about to be closed.
+static void
+flushout(int fd)
+{
+  if(fd >= 0){
+    fflush(fd);
+    if(fd < NOFILE)
+      obuf[fd].mode = 0;
+    return;
+  }
+  for(fd = 0; fd < NOFILE; fd++)
+    fflush(fd);
+}
+
+static void
+setmode(int fd)
+{
+  struct stat st;
+
+  if(fd == 2 || fstat(fd, &st) < 0)
+    obuf[fd].mode = OB_NONE;
+  else if(st.type == T_DEVICE)
+    obuf[fd].mode = OB_LINE;
+  else
+    obuf[fd].mode = OB_FULL;
+  outflush = flushout;
+}
+
 static void
 putc(int fd, char c)
 {
-  write(fd, &c, 1);
+  if(fd < 0 || fd >= NOFILE){
+    write(fd, &c, 1);
+    return;
+  }
+  if(obuf[fd].mode == 0)
+    setmode(fd);
+  obuf[fd].buf[obuf[fd].n++] = c;
+  if(obuf[fd].n == OBUFSIZE || (c == '\n' && obuf[fd].mode == OB_LINE))
+    fflush(fd);
 }
 
 static void
@@ -92,6 +158,8 @@ vprintf(int fd, const char *fmt, va_list ap)
       state = 0;
     }
   }
+  if(fd >= 0 && fd < NOFILE && obuf[fd].mode == OB_NONE)
+    fflush(fd);
 }
 
 void
@@ -0,0 +1,181 @@
+// sysstat: print per-system-call counts and latency histograms.
+//
+//   sysstat [-h] [-i] [cpu]
+//
+// latencies are in timer cycles (CLINT_MTIME ticks).
+// -h also prints each system call's log2 latency histogram.
+// -i also prints each CPU's time spent idle, in milliseconds.
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "kernel/syscall.h"
+#include "kernel/sysstat.h"
+#include "user/user.h"
+
+#define MAXSYS 64
+
+static char *names[MAXSYS] = {
+[SYS_fork]    "fork",
+[SYS_exit]    "exit",
+[SYS_wait]    "wait",
+[SYS_pipe]    "pipe",
+[SYS_read]    "read",
+[SYS_kill]    "kill",
+[SYS_exec]    "exec",
+[SYS_fstat]   "fstat",
+[SYS_chdir]   "chdir",
+[SYS_dup]     "dup",
+[SYS_getpid]  "getpid",
+[SYS_sbrk]    "sbrk",
+[SYS_sleep]   "sleep",
+[SYS_uptime]  "uptime",
+[SYS_open]    "open",
+[SYS_write]   "write",
+[SYS_mknod]   "mknod",
+[SYS_unlink]  "unlink",
+[SYS_link]    "link",
+[SYS_mkdir]   "mkdir",
+[SYS_close]   "close",
+[SYS_sysstat] "sysstat",
+[SYS_tracectl]  "tracectl",
+[SYS_traceread] "traceread",
+[SYS_fcntl]   "fcntl",
+[SYS_splice]  "splice",
+[SYS_mount]   "mount",
+[SYS_readv]   "readv",
+[SYS_writev]  "writev",
+[SYS_pread]   "pread",
+[SYS_pwrite]  "pwrite",
+[SYS_lseek]   "lseek",
+[SYS_ringsetup] "ringsetup",
+[SYS_ringenter] "ringenter",
+[SYS_poll]    "poll",
+[SYS_getdents] "getdents",
+[SYS_clock_gettime] "clock_gettime",
+[SYS_idletime] "idletime",
+};
+
+static struct sysstat st[MAXSYS];
+static uint64 idle[NCPU];
+
+// upper bound of the histogram bucket containing
+// the frac/100'th fastest call.
+static uint64
+percentile(struct sysstat *s, int frac)
+{
+  uint64 seen, want;
+  int i;
+
+  want = (s->count * frac + 99) / 100;
+  seen = 0;
+  for(i = 0; i < NSYSHIST; i++){
+    seen += s->hist[i];
+    if(seen >= want)
+      break;
+  }
+  return 2L << i;
+}
+
+// print s left-justified in a 10-character column.
+static void
+col(char *s)
+{
+  int i;
+
+  printf("%s", s);
+  for(i = strlen(s); i < 10; i++)
+    printf(" ");
+}
+
+static void
+colnum(uint64 x)
+{
+  char buf[24];
+  int i;
+
+  i = sizeof(buf) - 1;
+  buf[i] = 0;
+  do {
+    buf[--i] = '0' + x % 10;
+  } while((x /= 10) != 0);
+  col(buf + i);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int i, j, n, cpu, hist, idl;
+  char *name;
+
+  cpu = -1;
+  hist = 0;
+  idl = 0;
+  for(i = 1; i < argc; i++){
+    if(strcmp(argv[i], "-h") == 0)
+      hist = 1;
+    else if(strcmp(argv[i], "-i") == 0)
+      idl = 1;
+    else if(argv[i][0] >= '0' && argv[i][0] <= '9')
+      cpu = atoi(argv[i]);
+    else {
+      fprintf(2, "usage: sysstat [-h] [-i] [cpu]\n");
+      exit(1);
+    }
+  }
+
+  if((n = sysstat(cpu, st, MAXSYS)) < 0){
+    fprintf(2, "sysstat: failed\n");
+    exit(1);
+  }
+
+  col("syscall"); col("calls"); col("errors");
+  col("avg"); col("p50<"); col("p99<");
+  printf("\n");
+  if(hist){
+    // each histogram bucket is a row of [>=, <) cycles, calls.
+    col(""); col(">="); col("<"); col("calls");
+    printf("\n");
+  }
+  for(i = 0; i < n; i++){
+    if(st[i].count == 0)
+      continue;
+    name = (i < MAXSYS && names[i]) ? names[i] : "?";
+    col(name);
+    colnum(st[i].count);
+    colnum(st[i].errors);
+    colnum(st[i].cycles / st[i].count);
+    colnum(percentile(&st[i], 50));
+    colnum(percentile(&st[i], 99));
+    printf("\n");
+    if(hist){
+      for(j = 0; j < NSYSHIST; j++){
+        if(st[i].hist[j] == 0)
+          continue;
+        // bucket 0 also holds calls that took 0 cycles.
+        col("");
+        colnum(j == 0 ? 0 : 1L << j);
+        colnum(2L << j);
+        colnum(st[i].hist[j]);
+        printf("\n");
+      }
+    }
+  }
+
+  if(idl){
+    if((n = idletime(idle, NCPU)) < 0){
+      fprintf(2, "sysstat: idletime failed\n");
+      exit(1);
+    }
+    printf("\n");
+    col("cpu"); col("idle ms");
+    printf("\n");
+    for(i = 0; i < n; i++){
+      if(cpu >= 0 && i != cpu)
+        continue;
+      colnum(i);
+      colnum(idle[i] / 1000000);
+      printf("\n");
+    }
+  }
+  exit(0);
+}
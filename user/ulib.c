@@ -1,8 +1,56 @@
 #include "kernel/types.h"
 #include "kernel/stat.h"
 #include "kernel/fcntl.h"
+#include "kernel/riscv.h"
+#include "kernel/memlayout.h"
+#include "kernel/clock.h"
 #include "user/user.h"
 
+// the system call stubs behind the wrappers below.
+int _fork(void);
+int _exit(int) __attribute__((noreturn));
+int _exec(char*, char**);
+int _close(int);
+
+// printf.c sets this once it has buffered output for an fd.
+// fork(), exec() and exit() call it with -1 to flush every
+// buffer, close() with the fd to flush and forget it.  a
+// pointer rather than a call keeps printf.o out of programs
+// that don't print, like forktest.
+void (*outflush)(int);
+
+int
+fork(void)
+{
+  if(outflush)
+    outflush(-1);
+  return _fork();
+}
+
+int
+exit(int status)
+{
+  if(outflush)
+    outflush(-1);
+  _exit(status);
+}
+
+int
+exec(char *path, char **argv)
+{
+  if(outflush)
+    outflush(-1);
+  return _exec(path, argv);
+}
+
+int
+close(int fd)
+{
+  if(outflush)
+    outflush(fd);
+  return _close(fd);
+}
+
 char*
 strcpy(char *s, const char *t)
 {
@@ -32,14 +80,37 @@ strlen(const char *s)
   return n;
 }
 
+// memset, memmove and memcmp go a uint64 at a time, 64 bytes
+// per iteration, between byte-at-a-time unaligned heads and
+// tails; see kernel/string.c.
+
+#define ALIGNED(p) (((uint64)(p) & 7) == 0)
+
 void*
 memset(void *dst, int c, uint n)
 {
-  char *cdst = (char *) dst;
-  int i;
-  for(i = 0; i < n; i++){
-    cdst[i] = c;
+  char *d = dst;
+  uint64 w, *wd;
+
+  while(n > 0 && !ALIGNED(d)){
+    *d++ = c;
+    n--;
+  }
+  if(n >= 8){
+    w = (uchar)c;
+    w |= w << 8;
+    w |= w << 16;
+    w |= w << 32;
+    for(wd = (uint64*)d; n >= 64; n -= 64, wd += 8){
+      wd[0] = w; wd[1] = w; wd[2] = w; wd[3] = w;
+      wd[4] = w; wd[5] = w; wd[6] = w; wd[7] = w;
+    }
+    for(; n >= 8; n -= 8)
+      *wd++ = w;
+    d = (char*)wd;
   }
+  while(n-- > 0)
+    *d++ = c;
   return dst;
 }
 
@@ -58,6 +129,9 @@ gets(char *buf, int max)
   int i, cc;
   char c;
 
+  // let a prompt without a newline reach the console.
+  if(outflush)
+    outflush(-1);
   for(i=0; i+1 < max; ){
     cc = read(0, &c, 1);
     if(cc < 1)
@@ -100,15 +174,53 @@ memmove(void *vdst, const void *vsrc, int n)
 {
   char *dst;
   const char *src;
+  const uint64 *ws;
+  uint64 *wd;
+  int words;
 
   dst = vdst;
   src = vsrc;
+  words = ((uint64)src & 7) == ((uint64)dst & 7);
   if (src > dst) {
+    if (words) {
+      while (n > 0 && !ALIGNED(dst)) {
+        *dst++ = *src++;
+        n--;
+      }
+      ws = (const uint64*)src;
+      wd = (uint64*)dst;
+      for (; n >= 64; n -= 64, ws += 8, wd += 8) {
+        wd[0] = ws[0]; wd[1] = ws[1]; wd[2] = ws[2]; wd[3] = ws[3];
+        wd[4] = ws[4]; wd[5] = ws[5]; wd[6] = ws[6]; wd[7] = ws[7];
+      }
+      for (; n >= 8; n -= 8)
+        *wd++ = *ws++;
+      src = (const char*)ws;
+      dst = (char*)wd;
+    }
     while(n-- > 0)
       *dst++ = *src++;
   } else {
     dst += n;
     src += n;
+    if (words) {
+      while (n > 0 && !ALIGNED(dst)) {
+        *--dst = *--src;
+        n--;
+      }
+      ws = (const uint64*)src;
+      wd = (uint64*)dst;
+      for (; n >= 64; n -= 64) {
+        ws -= 8;
+        wd -= 8;
+        wd[7] = ws[7]; wd[6] = ws[6]; wd[5] = ws[5]; wd[4] = ws[4];
+        wd[3] = ws[3]; wd[2] = ws[2]; wd[1] = ws[1]; wd[0] = ws[0];
+      }
+      for (; n >= 8; n -= 8)
+        *--wd = *--ws;
+      src = (const char*)ws;
+      dst = (char*)wd;
+    }
     while(n-- > 0)
       *--dst = *--src;
   }
@@ -119,6 +231,21 @@ int
 memcmp(const void *s1, const void *s2, uint n)
 {
   const char *p1 = s1, *p2 = s2;
+  if (((uint64)p1 & 7) == ((uint64)p2 & 7)) {
+    while (n > 0 && !ALIGNED(p1) && *p1 == *p2) {
+      n--;
+      p1++;
+      p2++;
+    }
+    if (ALIGNED(p1)) {
+      // skip equal words; the bytes below find any difference.
+      while (n >= 8 && *(uint64*)p1 == *(uint64*)p2) {
+        n -= 8;
+        p1 += 8;
+        p2 += 8;
+      }
+    }
+  }
   while (n-- > 0) {
     if (*p1 != *p2) {
       return *p1 - *p2;
@@ -134,3 +261,14 @@ memcpy(void *dst, const void *src, uint n)
 {
   return memmove(dst, src, n);
 }
+
+// nanoseconds since boot, the same as clock_gettime()'s
+// CLOCK_MONOTONIC, but read from the time CSR and the clock
+// page without a system call.
+uint64
+uptimens(void)
+{
+  struct clockpage *cp = (struct clockpage *)CLOCKPAGE;
+
+  return clockns(r_time() - cp->boottime, cp->freq);
+}
@@ -3,8 +3,20 @@
 #include "user/user.h"
 #include "kernel/param.h"
 
-// Memory allocator by Kernighan and Ritchie,
-// The C programming Language, 2nd ed.  Section 8.7.
+// Memory allocator.
+//
+// Every block starts with a one-unit Header giving its size
+// in units.  Small blocks (up to SMALLUNITS units, header
+// included) come in power-of-two size classes, each with its
+// own free list, so small malloc() and free() are O(1).
+// Their storage is carved a slab at a time from the large
+// allocator and never given back to it.
+//
+// Larger blocks use the first-fit, address-ordered free list
+// of Kernighan and Ritchie, The C programming Language, 2nd
+// ed.  Section 8.7.  When a free leaves a large free block at
+// the end of the heap, all but MINCORE units of it are
+// returned to the kernel with a negative sbrk().
 
 typedef long Align;
 
@@ -18,15 +30,23 @@ union header {
 
 typedef union header Header;
 
+#define MINUNITS   2      // smallest class: 16 bytes of data
+#define SMALLUNITS 128    // largest class: 2032 bytes of data
+#define NCLASS     7      // MINUNITS << (NCLASS-1) == SMALLUNITS
+#define SLABUNITS  256    // a small class refill, 4096 bytes
+#define MINCORE    4096   // units to ask sbrk() for at least, and to keep
+
 static Header base;
 static Header *freep;
+static Header *smallfree[NCLASS];
 
-void
-free(void *ap)
+// return large block bp to the free list, merging it with
+// its neighbours.  returns the merged free block.
+static Header*
+lfree(Header *bp)
 {
-  Header *bp, *p;
+  Header *p;
 
-  bp = (Header*)ap - 1;
   for(p = freep; !(bp > p && bp < p->s.ptr); p = p->s.ptr)
     if(p >= p->s.ptr && (bp > p || bp < p->s.ptr))
       break;
@@ -38,9 +58,28 @@ free(void *ap)
   if(p + p->s.size == bp){
     p->s.size += bp->s.size;
     p->s.ptr = bp->s.ptr;
+    bp = p;
   } else
     p->s.ptr = bp;
   freep = p;
+  return bp;
+}
+
+// if free block bp ends the heap (nothing has been sbrk()'d
+// after it), give all but MINCORE units of it back.
+// sbrk() can refuse (it may need memory to split a
+// megapage); then bp keeps its size.
+static void
+trim(Header *bp)
+{
+  uint n;
+
+  if(bp->s.size >= 2*MINCORE && (char*)(bp + bp->s.size) == sbrk(0)){
+    n = bp->s.size - MINCORE;
+    bp->s.size = MINCORE;
+    if(sbrk(-(int)(n * sizeof(Header))) == (char*)-1)
+      bp->s.size += n;
+  }
 }
 
 static Header*
@@ -49,24 +88,24 @@ morecore(uint nu)
   char *p;
   Header *hp;
 
-  if(nu < 4096)
-    nu = 4096;
+  if(nu < MINCORE)
+    nu = MINCORE;
   p = sbrk(nu * sizeof(Header));
   if(p == (char*)-1)
     return 0;
   hp = (Header*)p;
   hp->s.size = nu;
-  free((void*)(hp + 1));
+  lfree(hp);
   return freep;
 }
 
-void*
-malloc(uint nbytes)
+// first-fit allocation of a block of exactly nunits units,
+// header included.
+static Header*
+lmalloc(uint nunits)
 {
   Header *p, *prevp;
-  uint nunits;
 
-  nunits = (nbytes + sizeof(Header) - 1)/sizeof(Header) + 1;
   if((prevp = freep) == 0){
     base.s.ptr = freep = prevp = &base;
     base.s.size = 0;
@@ -81,10 +120,67 @@ malloc(uint nbytes)
         p->s.size = nunits;
       }
       freep = prevp;
-      return (void*)(p + 1);
+      return p;
     }
     if(p == freep)
       if((p = morecore(nunits)) == 0)
         return 0;
   }
 }
+
+// fill class c, whose blocks are u units, with a new slab.
+static int
+refill(int c, uint u)
+{
+  Header *p, *slab;
+
+  if((slab = lmalloc(SLABUNITS)) == 0)
+    return -1;
+  for(p = slab + SLABUNITS - u; p >= slab; p -= u){
+    p->s.size = u;
+    p->s.ptr = smallfree[c];
+    smallfree[c] = p;
+  }
+  return 0;
+}
+
+void
+free(void *ap)
+{
+  Header *bp;
+  uint u;
+  int c;
+
+  bp = (Header*)ap - 1;
+  if(bp->s.size > SMALLUNITS){
+    trim(lfree(bp));
+    return;
+  }
+  for(c = 0, u = MINUNITS; u < bp->s.size; c++, u <<= 1)
+    ;
+  bp->s.ptr = smallfree[c];
+  smallfree[c] = bp;
+}
+
+void*
+malloc(uint nbytes)
+{
+  Header *p;
+  uint nunits, u;
+  int c;
+
+  nunits = (nbytes + sizeof(Header) - 1)/sizeof(Header) + 1;
+  if(nunits > SMALLUNITS){
+    if((p = lmalloc(nunits)) == 0)
+      return 0;
+    return (void*)(p + 1);
+  }
+
+  for(c = 0, u = MINUNITS; u < nunits; c++, u <<= 1)
+    ;
+  if(smallfree[c] == 0 && refill(c, u) < 0)
+    return 0;
+  p = smallfree[c];
+  smallfree[c] = p->s.ptr;
+  return (void*)(p + 1);
+}
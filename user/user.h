@@ -1,5 +1,11 @@
 struct stat;
 struct rtcdate;
+struct sysstat;
+struct traceevent;
+struct iovec;
+struct ioring;
+struct pollfd;
+struct dentry;
 
 // system calls
 int fork(void);
@@ -23,6 +29,23 @@ int getpid(void);
 char* sbrk(int);
 int sleep(int);
 int uptime(void);
+int sysstat(int, struct sysstat*, int);
+int tracectl(int);
+int traceread(struct traceevent*, int);
+int fcntl(int, int, int);
+int splice(int, int, int);
+int mount(const char*, const char*);
+int readv(int, const struct iovec*, int);
+int writev(int, const struct iovec*, int);
+int pread(int, void*, int, int);
+int pwrite(int, const void*, int, int);
+int lseek(int, int, int);
+struct ioring* ringsetup(int);
+int ringenter(void);
+int poll(struct pollfd*, int, int);
+int getdents(int, struct dentry*, int, int);
+int clock_gettime(int, uint64*);
+int idletime(uint64*, int);
 
 // ulib.c
 int stat(const char*, struct stat*);
@@ -32,6 +55,7 @@ char* strchr(const char*, char c);
 int strcmp(const char*, const char*);
 void fprintf(int, const char*, ...);
 void printf(const char*, ...);
+void fflush(int);
 char* gets(char*, int max);
 uint strlen(const char*);
 void* memset(void*, int, uint);
@@ -40,3 +64,4 @@ void free(void*);
 int atoi(const char*);
 int memcmp(const void*, const void*, uint);
 void* memcpy(void*, const void*, uint);
+uint64 uptimens(void);
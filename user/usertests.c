@@ -4,7 +4,13 @@
 #include "user/user.h"
 #include "kernel/fs.h"
 #include "kernel/fcntl.h"
+#include "kernel/iovec.h"
+#include "kernel/ioring.h"
+#include "kernel/poll.h"
+#include "kernel/clock.h"
 #include "kernel/syscall.h"
+#include "kernel/trace.h"
+#include "kernel/sysstat.h"
 #include "kernel/memlayout.h"
 #include "kernel/riscv.h"
 
@@ -22,6 +28,13 @@
 char buf[BUFSZ];
 char name[3];
 
+int countfree();
+
+// pages that may stay with the kernel's small-object
+// allocator after a test: each CPU's per-class magazines
+// can keep a slab of each of its six size classes busy.
+#define SLABSLACK (NCPU*6)
+
 // what if you pass ridiculous pointers to system calls
 // that read user memory with copyin?
 void
@@ -233,6 +246,40 @@ copyinstr3(char *s)
   }
 }
 
+// the kernel can reach the stack guard page below the stack,
+// but must not read or write it on the user's behalf.
+void
+copyguard(char *s)
+{
+  char buf[8];
+  char *guard = (char *) PGROUNDDOWN((uint64) buf) - PGSIZE;
+
+  int fd = open("README", 0);
+  if(fd < 0){
+    printf("%s: open(README) failed\n", s);
+    exit(1);
+  }
+  int n = read(fd, guard + PGSIZE - 4, 8);
+  if(n > 0){
+    printf("%s: read into guard page returned %d\n", s, n);
+    exit(1);
+  }
+  close(fd);
+
+  int fds[2];
+  if(pipe(fds) < 0){
+    printf("%s: pipe() failed\n", s);
+    exit(1);
+  }
+  n = write(fds[1], guard, 8);
+  if(n > 0){
+    printf("%s: write from guard page returned %d\n", s, n);
+    exit(1);
+  }
+  close(fds[0]);
+  close(fds[1]);
+}
+
 // test O_TRUNC.
 void
 truncate1(char *s)
@@ -735,6 +782,770 @@ pipe1(char *s)
   }
 }
 
+// resize a pipe with fcntl(F_SETPIPE_SZ) and fill it
+// to capacity without a reader.
+void
+pipesize(char *s)
+{
+  int fds[2], i, n, sz;
+  enum { SZ=10000 };
+
+  if(pipe(fds) != 0){
+    printf("%s: pipe() failed\n", s);
+    exit(1);
+  }
+  if(fcntl(fds[0], F_GETPIPE_SZ, 0) != PGSIZE){
+    printf("%s: default pipe size wrong\n", s);
+    exit(1);
+  }
+  if(fcntl(fds[1], F_SETPIPE_SZ, 1<<30) != -1){
+    printf("%s: huge pipe size accepted\n", s);
+    exit(1);
+  }
+  if((sz = fcntl(fds[1], F_SETPIPE_SZ, SZ)) < SZ){
+    printf("%s: F_SETPIPE_SZ returned %d\n", s, sz);
+    exit(1);
+  }
+  for(n = 0; n < sz; n += PGSIZE){
+    memset(buf, n / PGSIZE, PGSIZE);
+    if(write(fds[1], buf, PGSIZE) != PGSIZE){
+      printf("%s: write failed\n", s);
+      exit(1);
+    }
+  }
+  if(fcntl(fds[1], F_SETPIPE_SZ, PGSIZE) != -1){
+    printf("%s: shrank a full pipe\n", s);
+    exit(1);
+  }
+  close(fds[1]);
+  for(n = 0; (i = read(fds[0], buf, PGSIZE)) > 0; n += i){
+    if(buf[0] != n / PGSIZE || buf[i-1] != (n+i-1) / PGSIZE){
+      printf("%s: wrong data\n", s);
+      exit(1);
+    }
+  }
+  if(n != sz){
+    printf("%s: read %d of %d\n", s, n, sz);
+    exit(1);
+  }
+  close(fds[0]);
+}
+
+// splice a file into a pipe and the pipe back out to
+// another file.
+void
+splicetest(char *s)
+{
+  int fd, fds[2], i, n;
+  enum { SZ=3*BSIZE+17 };
+
+  unlink("splice0");
+  unlink("splice1");
+  fd = open("splice0", O_CREATE|O_RDWR);
+  if(fd < 0){
+    printf("%s: create splice0 failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < SZ; i++)
+    buf[i] = i % 251;
+  if(write(fd, buf, SZ) != SZ){
+    printf("%s: write splice0 failed\n", s);
+    exit(1);
+  }
+  close(fd);
+
+  if(pipe(fds) != 0){
+    printf("%s: pipe() failed\n", s);
+    exit(1);
+  }
+  fd = open("splice0", O_RDONLY);
+  if((n = splice(fd, fds[1], SZ + 100)) != SZ){
+    printf("%s: splice file to pipe returned %d\n", s, n);
+    exit(1);
+  }
+  if(splice(fds[0], fd, 1) != -1){
+    printf("%s: spliced into a read-only file\n", s);
+    exit(1);
+  }
+  close(fd);
+  close(fds[1]);
+
+  fd = open("splice1", O_CREATE|O_RDWR);
+  for(n = 0; (i = splice(fds[0], fd, 1000)) > 0; n += i)
+    ;
+  if(i < 0 || n != SZ){
+    printf("%s: splice pipe to file moved %d\n", s, n);
+    exit(1);
+  }
+  close(fds[0]);
+  close(fd);
+
+  fd = open("splice1", O_RDONLY);
+  memset(buf, 0, SZ);
+  if(read(fd, buf, sizeof(buf)) != SZ){
+    printf("%s: splice1 has wrong size\n", s);
+    exit(1);
+  }
+  for(i = 0; i < SZ; i++){
+    if((buf[i] & 0xff) != i % 251){
+      printf("%s: splice1 has wrong data at %d\n", s, i);
+      exit(1);
+    }
+  }
+  close(fd);
+  unlink("splice0");
+  unlink("splice1");
+}
+
+// files under /tmp live in the in-memory tmpfs that
+// init mounts there.
+void
+tmpfstest(char *s)
+{
+  int fd, i;
+  struct stat st;
+  char name[10];
+
+  unlink("/tmp/tmpfs0");
+  fd = open("/tmp/tmpfs0", O_CREATE|O_RDWR);
+  if(fd < 0){
+    printf("%s: create /tmp/tmpfs0 failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < 3*PGSIZE; i++)
+    buf[i] = i % 253;
+  if(write(fd, buf, 3*PGSIZE) != 3*PGSIZE){
+    printf("%s: write /tmp/tmpfs0 failed\n", s);
+    exit(1);
+  }
+  if(fstat(fd, &st) < 0 || st.dev != TMPDEV || st.size != 3*PGSIZE){
+    printf("%s: /tmp/tmpfs0 has wrong stat\n", s);
+    exit(1);
+  }
+  close(fd);
+
+  if(chdir("/tmp") < 0){
+    printf("%s: chdir /tmp failed\n", s);
+    exit(1);
+  }
+  fd = open("tmpfs0", O_RDONLY);
+  memset(buf, 0, 3*PGSIZE);
+  if(fd < 0 || read(fd, buf, sizeof(buf)) != 3*PGSIZE){
+    printf("%s: read tmpfs0 failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < 3*PGSIZE; i++){
+    if((buf[i] & 0xff) != i % 253){
+      printf("%s: tmpfs0 has wrong data\n", s);
+      exit(1);
+    }
+  }
+  close(fd);
+
+  // ".." leaves the mounted file system.
+  if(stat("..", &st) < 0 || st.dev != ROOTDEV || st.ino != ROOTINO){
+    printf("%s: /tmp/.. is not /\n", s);
+    exit(1);
+  }
+  if(unlink("tmpfs0") < 0){
+    printf("%s: unlink tmpfs0 failed\n", s);
+    exit(1);
+  }
+  if(chdir("/") < 0 || unlink("/tmp") == 0){
+    printf("%s: unlinked a mount point\n", s);
+    exit(1);
+  }
+
+  // running out of tmpfs inodes fails the create,
+  // rather than the kernel.
+  name[0] = '/'; name[1] = 't'; name[2] = 'm'; name[3] = 'p';
+  name[4] = '/'; name[5] = 'f'; name[9] = '\0';
+  for(i = 0; i < 1000; i++){
+    name[6] = '0' + i / 100;
+    name[7] = '0' + (i / 10) % 10;
+    name[8] = '0' + i % 10;
+    if((fd = open(name, O_CREATE|O_RDWR)) < 0)
+      break;
+    close(fd);
+  }
+  if(i == 0 || i == 1000){
+    printf("%s: filled /tmp with %d files\n", s, i);
+    exit(1);
+  }
+  while(--i >= 0){
+    name[6] = '0' + i / 100;
+    name[7] = '0' + (i / 10) % 10;
+    name[8] = '0' + i % 10;
+    if(unlink(name) < 0){
+      printf("%s: unlink %s failed\n", s, name);
+      exit(1);
+    }
+  }
+  if((fd = open("/tmp/tmpfs0", O_CREATE|O_RDWR)) < 0){
+    printf("%s: no inodes after emptying /tmp\n", s);
+    exit(1);
+  }
+  close(fd);
+  unlink("/tmp/tmpfs0");
+}
+
+// gather three buffers with writev(), scatter them
+// differently with readv().
+void
+iovtest(char *s)
+{
+  struct iovec iov[3];
+  char a[10], b[100], c[1000];
+  int fd, i, n;
+
+  memset(a, 'a', sizeof(a));
+  memset(b, 'b', sizeof(b));
+  memset(c, 'c', sizeof(c));
+  iov[0].iov_base = a; iov[0].iov_len = sizeof(a);
+  iov[1].iov_base = b; iov[1].iov_len = sizeof(b);
+  iov[2].iov_base = c; iov[2].iov_len = sizeof(c);
+
+  unlink("iovfile");
+  fd = open("iovfile", O_CREATE|O_RDWR);
+  if(fd < 0){
+    printf("%s: create iovfile failed\n", s);
+    exit(1);
+  }
+  if((n = writev(fd, iov, 3)) != 1110){
+    printf("%s: writev returned %d\n", s, n);
+    exit(1);
+  }
+  close(fd);
+
+  fd = open("iovfile", O_RDONLY);
+  iov[0].iov_base = buf; iov[0].iov_len = 55;
+  iov[1].iov_base = buf + 55; iov[1].iov_len = 5000;
+  if((n = readv(fd, iov, 2)) != 1110){
+    printf("%s: readv returned %d\n", s, n);
+    exit(1);
+  }
+  for(i = 0; i < n; i++){
+    if(buf[i] != (i < 10 ? 'a' : i < 110 ? 'b' : 'c')){
+      printf("%s: wrong data at %d\n", s, i);
+      exit(1);
+    }
+  }
+  if(readv(fd, iov, IOV_MAX+1) != -1){
+    printf("%s: readv accepted too many iovecs\n", s);
+    exit(1);
+  }
+  close(fd);
+  unlink("iovfile");
+}
+
+// lseek() moves the offset; pread()/pwrite() don't.
+void
+seektest(char *s)
+{
+  int fd, i;
+  char c[8];
+
+  unlink("seekfile");
+  fd = open("seekfile", O_CREATE|O_RDWR);
+  if(fd < 0){
+    printf("%s: create seekfile failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < 5000; i++)
+    buf[i] = i % 251;
+  if(write(fd, buf, 5000) != 5000){
+    printf("%s: write failed\n", s);
+    exit(1);
+  }
+  if(lseek(fd, 1000, SEEK_SET) != 1000 || read(fd, c, 1) != 1 ||
+     (c[0] & 0xff) != 1000 % 251){
+    printf("%s: SEEK_SET failed\n", s);
+    exit(1);
+  }
+  if(pread(fd, c, 1, 4000) != 1 || (c[0] & 0xff) != 4000 % 251){
+    printf("%s: pread failed\n", s);
+    exit(1);
+  }
+  if(lseek(fd, 0, SEEK_CUR) != 1001){
+    printf("%s: pread moved the offset\n", s);
+    exit(1);
+  }
+  c[0] = 'P';
+  if(pwrite(fd, c, 1, 2000) != 1 || lseek(fd, -10, SEEK_CUR) != 991){
+    printf("%s: pwrite failed\n", s);
+    exit(1);
+  }
+  if(lseek(fd, -1, SEEK_SET) != -1 || lseek(fd, 0, 7) != -1){
+    printf("%s: bad lseek accepted\n", s);
+    exit(1);
+  }
+  if(lseek(fd, -3000, SEEK_END) != 2000 || read(fd, c, 2) != 2 ||
+     c[0] != 'P' || (c[1] & 0xff) != 2001 % 251){
+    printf("%s: SEEK_END failed\n", s);
+    exit(1);
+  }
+  close(fd);
+  unlink("seekfile");
+}
+
+// queue open/write/fstat/close on a ring and run them
+// with one ringenter().
+void
+ringtest(char *s)
+{
+  struct ioring *r;
+  struct sqe *e;
+  struct stat st;
+  char *path = "ringfile";
+  int i, fd;
+
+  unlink(path);
+  r = ringsetup(0);
+  if(r == (struct ioring*)-1){
+    printf("%s: ringsetup failed\n", s);
+    exit(1);
+  }
+  if(ringsetup(0) != (struct ioring*)-1){
+    printf("%s: second ringsetup succeeded\n", s);
+    exit(1);
+  }
+
+  // the fd open() will return.
+  fd = dup(0);
+  close(fd);
+
+  e = &r->sq[r->sqtail++ % RINGSIZE];
+  e->op = RING_OPEN; e->addr = (uint64)path; e->n = O_CREATE|O_RDWR; e->tag = 1;
+  e = &r->sq[r->sqtail++ % RINGSIZE];
+  e->op = RING_WRITE; e->fd = fd; e->addr = (uint64)"hello"; e->n = 5; e->tag = 2;
+  e = &r->sq[r->sqtail++ % RINGSIZE];
+  e->op = RING_FSTAT; e->fd = fd; e->addr = (uint64)&st; e->tag = 3;
+  e = &r->sq[r->sqtail++ % RINGSIZE];
+  e->op = RING_CLOSE; e->fd = fd; e->tag = 4;
+  e = &r->sq[r->sqtail++ % RINGSIZE];
+  e->op = 99; e->tag = 5;
+
+  if(ringenter() != 5 || r->cqtail - r->cqhead != 5){
+    printf("%s: ringenter ran the wrong number of entries\n", s);
+    exit(1);
+  }
+  for(i = 0; i < 5; i++){
+    struct cqe *c = &r->cq[r->cqhead++ % RINGSIZE];
+    int want = i == 0 ? fd : i == 1 ? 5 : i == 4 ? -1 : 0;
+    if(c->tag != i+1 || c->res != want){
+      printf("%s: completion %d: tag %d res %d\n", s, i, (int)c->tag, c->res);
+      exit(1);
+    }
+  }
+  if(st.size != 5 || st.type != T_FILE){
+    printf("%s: ring fstat wrong\n", s);
+    exit(1);
+  }
+  if(close(fd) != -1){
+    printf("%s: ring close didn't close\n", s);
+    exit(1);
+  }
+  unlink(path);
+}
+
+// a RING_POLL ring runs its entries on any trap into the
+// kernel, without ringenter(): on a system call, or, for
+// a process spinning in user space, when its quantum ends.
+void
+ringpolltest(char *s)
+{
+  volatile struct ioring *r;
+  volatile struct sqe *e;
+  uint64 t0;
+  int fds[2];
+  char c;
+
+  if(pipe(fds) != 0){
+    printf("%s: pipe() failed\n", s);
+    exit(1);
+  }
+  r = ringsetup(RING_POLL);
+  if(r == (struct ioring*)-1){
+    printf("%s: ringsetup failed\n", s);
+    exit(1);
+  }
+
+  // a system call drains the ring.
+  e = &r->sq[r->sqtail % RINGSIZE];
+  e->op = RING_WRITE; e->fd = fds[1]; e->addr = (uint64)"a"; e->n = 1; e->tag = 1;
+  __sync_synchronize();
+  r->sqtail++;
+  getpid();
+  if(r->cqtail - r->cqhead != 1 || r->cq[r->cqhead % RINGSIZE].res != 1){
+    printf("%s: getpid() didn't drain the ring\n", s);
+    exit(1);
+  }
+  r->cqhead++;
+
+  // so does the end of the quantum, eventually.
+  e = &r->sq[r->sqtail % RINGSIZE];
+  e->op = RING_WRITE; e->fd = fds[1]; e->addr = (uint64)"b"; e->n = 1; e->tag = 2;
+  __sync_synchronize();
+  r->sqtail++;
+  t0 = uptimens();
+  while(r->cqtail == r->cqhead && uptimens() - t0 < 2000000000L)
+    ;
+  if(r->cqtail - r->cqhead != 1 || r->cq[r->cqhead % RINGSIZE].tag != 2){
+    printf("%s: spinning process's ring never drained\n", s);
+    exit(1);
+  }
+  r->cqhead++;
+
+  if(read(fds[0], &c, 1) != 1 || c != 'a' || read(fds[0], &c, 1) != 1 || c != 'b'){
+    printf("%s: ring writes went missing\n", s);
+    exit(1);
+  }
+  close(fds[0]);
+  close(fds[1]);
+}
+
+// poll() on pipes: readiness, a wakeup from another
+// process, hangup, and timeouts.
+void
+polltest(char *s)
+{
+  struct pollfd pfd[2];
+  int fds[2], pid, t0;
+  char c;
+
+  if(pipe(fds) != 0){
+    printf("%s: pipe() failed\n", s);
+    exit(1);
+  }
+  pfd[0].fd = fds[0];
+  pfd[0].events = POLLIN;
+  pfd[1].fd = fds[1];
+  pfd[1].events = POLLIN|POLLOUT;
+
+  // empty pipe: only the write end is ready.
+  if(poll(pfd, 2, 0) != 1 || pfd[0].revents != 0 || pfd[1].revents != POLLOUT){
+    printf("%s: empty pipe readiness wrong\n", s);
+    exit(1);
+  }
+
+  // nothing arrives, so a timed poll times out.
+  t0 = uptime();
+  if(poll(pfd, 1, 2) != 0 || uptime() - t0 < 2){
+    printf("%s: poll didn't time out\n", s);
+    exit(1);
+  }
+
+  // a child's write wakes an indefinite poll.
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    sleep(2);
+    write(fds[1], "x", 1);
+    exit(0);
+  }
+  if(poll(pfd, 1, -1) != 1 || pfd[0].revents != POLLIN){
+    printf("%s: poll missed the write\n", s);
+    exit(1);
+  }
+  if(read(fds[0], &c, 1) != 1 || c != 'x'){
+    printf("%s: read after poll failed\n", s);
+    exit(1);
+  }
+  wait(0);
+
+  // closing the write end reports a hangup.
+  close(fds[1]);
+  pfd[1].fd = -1;
+  if(poll(pfd, 2, -1) != 1 || (pfd[0].revents & POLLHUP) == 0 || pfd[1].revents != 0){
+    printf("%s: no hangup after close\n", s);
+    exit(1);
+  }
+  close(fds[0]);
+  if(poll(pfd, 1, 0) != 1 || pfd[0].revents != POLLNVAL){
+    printf("%s: closed fd not POLLNVAL\n", s);
+    exit(1);
+  }
+}
+
+// getdents() returns every entry, in small batches,
+// with the same type and size stat() reports.
+void
+getdentstest(char *s)
+{
+  struct dentry d[3];
+  struct stat st;
+  char name[16];
+  int i, j, n, fd, pid, xstatus, seen, total;
+
+  if(mkdir("gdd") < 0){
+    printf("%s: mkdir failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < 10; i++){
+    name[0] = 'g'; name[1] = 'd'; name[2] = 'd'; name[3] = '/';
+    name[4] = 'a' + i; name[5] = 0;
+    fd = open(name, O_CREATE|O_WRONLY);
+    if(fd < 0){
+      printf("%s: create %s failed\n", s, name);
+      exit(1);
+    }
+    write(fd, "xxxxxxxxxx", i);
+    close(fd);
+  }
+  unlink("gdd/e");
+
+  fd = open("gdd", O_RDONLY);
+  if(fd < 0){
+    printf("%s: open gdd failed\n", s);
+    exit(1);
+  }
+  seen = total = 0;
+  while((n = getdents(fd, d, 3, GD_STAT)) > 0){
+    if(n > 3){
+      printf("%s: getdents returned %d > 3\n", s, n);
+      exit(1);
+    }
+    for(i = 0; i < n; i++){
+      total++;
+      if(d[i].name[0] == '.')
+        continue;
+      name[4] = d[i].name[0];
+      if(stat(name, &st) < 0 || st.type != d[i].type ||
+         st.size != d[i].size || st.ino != d[i].inum){
+        printf("%s: entry %s doesn't match stat\n", s, d[i].name);
+        exit(1);
+      }
+      seen |= 1 << (d[i].name[0] - 'a');
+    }
+  }
+  if(n < 0 || total != 11 || seen != (0x3ff & ~(1 << 4))){
+    printf("%s: getdents saw %d entries, mask %x\n", s, total, seen);
+    exit(1);
+  }
+  close(fd);
+
+  if(getdents(0, d, 3, 0) >= 0){
+    printf("%s: getdents on a non-directory succeeded\n", s);
+    exit(1);
+  }
+  for(i = 0; i < 10; i++){
+    name[4] = 'a' + i;
+    unlink(name);
+  }
+  unlink("gdd");
+
+  // GD_STAT racing with unlink must neither panic nor
+  // report an entry with no type.
+  if(mkdir("gdr") < 0){
+    printf("%s: mkdir gdr failed\n", s);
+    exit(1);
+  }
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    for(i = 0; i < 200; i++){
+      fd = open("gdr/x", O_CREATE|O_WRONLY);
+      if(fd >= 0)
+        close(fd);
+      unlink("gdr/x");
+    }
+    exit(0);
+  }
+  for(i = 0; i < 200; i++){
+    fd = open("gdr", O_RDONLY);
+    if(fd < 0){
+      printf("%s: open gdr failed\n", s);
+      exit(1);
+    }
+    while((n = getdents(fd, d, 3, GD_STAT)) > 0){
+      for(j = 0; j < n; j++){
+        if(d[j].type == 0){
+          printf("%s: entry %s has no type\n", s, d[j].name);
+          exit(1);
+        }
+      }
+    }
+    close(fd);
+  }
+  wait(&xstatus);
+  unlink("gdr/x");
+  if(xstatus != 0 || unlink("gdr") < 0){
+    printf("%s: gdr race cleanup failed\n", s);
+    exit(1);
+  }
+}
+
+// clock_gettime() and the clock page tell the same time,
+// which moves forward; no one may write the clock page.
+void
+clocktest(char *s)
+{
+  uint64 t0, t1, t2;
+  int fd, pid, xstatus;
+
+  if(clock_gettime(CLOCK_MONOTONIC, &t0) < 0){
+    printf("%s: clock_gettime failed\n", s);
+    exit(1);
+  }
+  t1 = uptimens();
+  if(clock_gettime(CLOCK_MONOTONIC, &t2) < 0){
+    printf("%s: clock_gettime failed\n", s);
+    exit(1);
+  }
+  if(t1 < t0 || t2 < t1){
+    printf("%s: clock went backwards\n", s);
+    exit(1);
+  }
+  if(clock_gettime(-1, &t0) != -1){
+    printf("%s: clock_gettime of a bad clock succeeded\n", s);
+    exit(1);
+  }
+  sleep(1);
+  if(uptimens() <= t2){
+    printf("%s: clock stood still across sleep(1)\n", s);
+    exit(1);
+  }
+
+  fd = open("README", 0);
+  if(fd < 0){
+    printf("%s: open(README) failed\n", s);
+    exit(1);
+  }
+  if(read(fd, (void *)CLOCKPAGE, 8) > 0){
+    printf("%s: read into the clock page succeeded\n", s);
+    exit(1);
+  }
+  close(fd);
+
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    *(volatile uint64 *)CLOCKPAGE = 0;
+    exit(0);
+  }
+  wait(&xstatus);
+  if(xstatus != -1){
+    printf("%s: wrote the clock page\n", s);
+    exit(1);
+  }
+}
+
+// while this process sleeps, some CPU must be idle.
+void
+idletest(char *s)
+{
+  uint64 t0[NCPU], t1[NCPU], sum0, sum1;
+  int i, n;
+
+  if((n = idletime(t0, NCPU)) <= 0){
+    printf("%s: idletime returned %d\n", s, n);
+    exit(1);
+  }
+  sleep(2);
+  if(idletime(t1, NCPU) != n){
+    printf("%s: idletime changed its mind\n", s);
+    exit(1);
+  }
+  sum0 = sum1 = 0;
+  for(i = 0; i < n; i++){
+    if(t1[i] < t0[i]){
+      printf("%s: cpu %d idle time went backwards\n", s, i);
+      exit(1);
+    }
+    sum0 += t0[i];
+    sum1 += t1[i];
+  }
+  if(sum1 == sum0){
+    printf("%s: no cpu was idle\n", s);
+    exit(1);
+  }
+}
+
+// sysstat() counts every call of a system call.
+void
+sysstattest(char *s)
+{
+  static struct sysstat st0[SYS_getpid+1], st1[SYS_getpid+1];
+  int i, n;
+
+  n = SYS_getpid + 1;
+  if(sysstat(-1, st0, n) != n){
+    printf("%s: sysstat failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < 100; i++)
+    getpid();
+  if(sysstat(-1, st1, n) != n){
+    printf("%s: sysstat failed\n", s);
+    exit(1);
+  }
+  if(st1[SYS_getpid].count < st0[SYS_getpid].count + 100){
+    printf("%s: getpid count went from %d to %d\n", s,
+           (int)st0[SYS_getpid].count, (int)st1[SYS_getpid].count);
+    exit(1);
+  }
+  if(sysstat(0, st0, n) != n){
+    printf("%s: sysstat of cpu 0 failed\n", s);
+    exit(1);
+  }
+  if(sysstat(NCPU, st0, n) != -1){
+    printf("%s: sysstat of cpu %d succeeded\n", s, NCPU);
+    exit(1);
+  }
+}
+
+// with tracing on, a system call and a sleep() leave
+// TR_SYSCALL and TR_SCHED events for this process.
+void
+tracetest(char *s)
+{
+  struct traceevent ev[16];
+  int i, n, pid, on, sys, sched;
+
+  // discard anything already buffered.
+  on = tracectl(0);
+  while(traceread(ev, 16) > 0)
+    ;
+
+  pid = getpid();
+  tracectl(1);
+  getpid();
+  sleep(1);
+  tracectl(on);
+
+  sys = sched = 0;
+  while((n = traceread(ev, 16)) > 0){
+    for(i = 0; i < n; i++){
+      if(ev[i].type == TR_SYSCALL && ev[i].pid == pid && ev[i].a0 == SYS_getpid)
+        sys = 1;
+      if(ev[i].type == TR_SCHED && ev[i].a0 == pid)
+        sched = 1;
+    }
+  }
+  if(n < 0 || !sys || !sched){
+    printf("%s: traceread returned %d, syscall %d sched %d\n", s, n, sys, sched);
+    exit(1);
+  }
+
+  // a bad buffer fails, rather than faulting in the kernel.
+  tracectl(1);
+  getpid();
+  tracectl(on);
+  if(traceread((struct traceevent *)0xffffffffffffL, 16) != -1){
+    printf("%s: traceread to a bad address succeeded\n", s);
+    exit(1);
+  }
+}
+
 // meant to be run w/ at most two CPUs
 void
 preempt(char *s)
@@ -1006,6 +1817,117 @@ mem(char *s)
   }
 }
 
+// pipes, open files and inodes come from the kernel's
+// kmalloc(): churn them from several processes at once,
+// up to the NFILE limit, along with fork()s, and check
+// that the memory comes back afterwards.
+void
+slabtest(char *s)
+{
+  int fds[NOFILE];
+  int free0, free1, i, j, k, n, pid, xstatus;
+
+  free0 = countfree();
+  for(i = 0; i < 8; i++){
+    pid = fork();
+    if(pid < 0){
+      printf("%s: fork failed\n", s);
+      exit(1);
+    }
+    if(pid == 0){
+      for(j = 0; j < 20; j++){
+        // as many pipes as there are fds for.
+        for(n = 0; n + 2 <= NOFILE && pipe(&fds[n]) == 0; n += 2)
+          ;
+        for(k = 0; k < n; k += 2){
+          if(write(fds[k+1], "x", 1) != 1){
+            printf("%s: pipe write failed\n", s);
+            exit(1);
+          }
+        }
+        for(k = 0; k < n; k++)
+          close(fds[k]);
+
+        // then as many open files; eight processes at this
+        // run out of struct files (NFILE) before fds.
+        for(n = 0; n < NOFILE; n++)
+          if((fds[n] = open(n % 2 ? "README" : ".", O_RDONLY)) < 0)
+            break;
+        for(k = 0; k < n; k++)
+          close(fds[k]);
+
+        // and a few short-lived processes.
+        for(k = 0; k < 4; k++){
+          if((pid = fork()) == 0)
+            exit(0);
+        }
+        while(wait(0) >= 0)
+          ;
+      }
+      exit(0);
+    }
+  }
+  for(i = 0; i < 8; i++){
+    wait(&xstatus);
+    if(xstatus != 0)
+      exit(1);
+  }
+  free1 = countfree();
+  if(free1 < free0 - SLABSLACK){
+    printf("%s: lost %d pages\n", s, free0 - free1);
+    exit(1);
+  }
+}
+
+// small blocks are recycled by size class, and freeing a
+// large block at the end of the heap shrinks the heap.
+void
+malloctest(char *s)
+{
+  char *a[64], *p, *top;
+  int i, j;
+
+  for(i = 0; i < 64; i++){
+    if((a[i] = malloc(1 + i*30)) == 0){
+      printf("%s: small malloc failed\n", s);
+      exit(1);
+    }
+    memset(a[i], i, 1 + i*30);
+  }
+  for(i = 0; i < 64; i++){
+    for(j = 0; j < 1 + i*30; j++){
+      if(a[i][j] != (char)i){
+        printf("%s: small blocks overlap\n", s);
+        exit(1);
+      }
+    }
+  }
+  p = a[10];
+  free(a[10]);
+  if((a[10] = malloc(1 + 10*30)) != p){
+    printf("%s: freed small block not reused\n", s);
+    exit(1);
+  }
+  for(i = 0; i < 64; i++)
+    free(a[i]);
+
+  top = sbrk(0);
+  if((p = malloc(1024*1024)) == 0){
+    printf("%s: large malloc failed\n", s);
+    exit(1);
+  }
+  memset(p, 1, 1024*1024);
+  if(sbrk(0) < top + 1024*1024){
+    printf("%s: heap didn't grow\n", s);
+    exit(1);
+  }
+  free(p);
+  if(sbrk(0) >= top + 1024*1024){
+    printf("%s: heap wasn't trimmed\n", s);
+    exit(1);
+  }
+}
+
 // More file system tests
 
 // two processes write to the same file descriptor
@@ -2016,6 +2938,138 @@ sbrkbasic(char *s)
   exit(xstatus);
 }
 
+// a 2 MB-aligned heap region (megapages, if the kernel can)
+// survives fork(), and shrinking into the middle of it.
+void
+sbrkmega(char *s)
+{
+  enum { MEGA=2*1024*1024 };
+  char *a, *p;
+  uint64 i;
+  int pid, xstatus;
+
+  a = sbrk(0);
+  if(sbrk(MEGA - (uint64)a % MEGA + 2*MEGA) == (char*)-1){
+    printf("%s: sbrk failed\n", s);
+    exit(1);
+  }
+  a += MEGA - (uint64)a % MEGA;
+  for(i = 0; i < 2*MEGA; i += 512)
+    a[i] = i / 512;
+
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    for(i = 0; i < 2*MEGA; i += 512){
+      if(a[i] != (char)(i / 512)){
+        printf("%s: child sees wrong data at %p\n", s, a + i);
+        exit(1);
+      }
+    }
+    exit(0);
+  }
+  wait(&xstatus);
+  if(xstatus != 0)
+    exit(1);
+
+  // drop the second 2 MB and the last page of the first.
+  p = sbrk(-(MEGA + 4096));
+  if(p != a + 2*MEGA){
+    printf("%s: sbrk shrink failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < MEGA - 4096; i += 512){
+    if(a[i] != (char)(i / 512)){
+      printf("%s: wrong data at %p after shrink\n", s, a + i);
+      exit(1);
+    }
+  }
+  if(sbrk(MEGA + 4096) == (char*)-1 || a[MEGA] != 0 || a[MEGA - 4096] != 0){
+    printf("%s: regrown memory not zeroed\n", s);
+    exit(1);
+  }
+}
+
+// exercise the kernel's buddy allocator across orders:
+// megapages from sbrk() and fork(), split by shrinking
+// into their middle and freed a page at a time, mixed
+// with single pages.  a merge or split that loses pages
+// shows up in countfree().
+void
+buddytest(char *s)
+{
+  enum { MEGA=2*1024*1024 };
+  char *a, *top;
+  int free0, free1, i, pid, xstatus;
+  uint64 j;
+
+  free0 = countfree();
+  top = sbrk(0);
+  for(i = 0; i < 5; i++){
+    // an odd number of pages, so the megapages start
+    // at a different offset into the heap each round.
+    if(sbrk((2*i + 1) * 4096) == (char*)-1){
+      printf("%s: sbrk failed\n", s);
+      exit(1);
+    }
+    a = sbrk(0);
+    if(sbrk(MEGA - (uint64)a % MEGA + 3*MEGA) == (char*)-1){
+      printf("%s: sbrk failed\n", s);
+      exit(1);
+    }
+    a += MEGA - (uint64)a % MEGA;
+    for(j = 0; j < 3*MEGA; j += 4096)
+      a[j] = i;
+
+    // the child's copy takes megapages too.
+    pid = fork();
+    if(pid < 0){
+      printf("%s: fork failed\n", s);
+      exit(1);
+    }
+    if(pid == 0){
+      for(j = 0; j < 3*MEGA; j += 4096)
+        if(a[j] != i)
+          exit(1);
+      exit(0);
+    }
+    wait(&xstatus);
+    if(xstatus != 0){
+      printf("%s: child saw wrong data\n", s);
+      exit(1);
+    }
+
+    // split the last megapage, then the middle one a page
+    // at a time, then give everything back.
+    if(sbrk(-(MEGA/2)) == (char*)-1){
+      printf("%s: sbrk shrink failed\n", s);
+      exit(1);
+    }
+    for(j = 0; j < 8; j++){
+      if(sbrk(-(MEGA/2 + 4096)) == (char*)-1){
+        printf("%s: sbrk shrink failed\n", s);
+        exit(1);
+      }
+      if(sbrk(MEGA/2) == (char*)-1){
+        printf("%s: sbrk regrow failed\n", s);
+        exit(1);
+      }
+    }
+    if(sbrk(top - sbrk(0)) == (char*)-1){
+      printf("%s: sbrk shrink failed\n", s);
+      exit(1);
+    }
+  }
+  free1 = countfree();
+  if(free1 < free0 - SLABSLACK){
+    printf("%s: lost %d pages\n", s, free0 - free1);
+    exit(1);
+  }
+}
+
 void
 sbrkmuch(char *s)
 {
@@ -2644,6 +3698,7 @@ main(int argc, char *argv[])
     {copyinstr1, "copyinstr1"},
     {copyinstr2, "copyinstr2"},
     {copyinstr3, "copyinstr3"},
+    {copyguard, "copyguard"},
     {truncate1, "truncate1"},
     {truncate2, "truncate2"},
     {truncate3, "truncate3"},
@@ -2671,6 +3726,8 @@ main(int argc, char *argv[])
     {bsstest, "bsstest"},
     {sbrkbasic, "sbrkbasic"},
     {sbrkmuch, "sbrkmuch"},
+    {sbrkmega, "sbrkmega"},
+    {buddytest, "buddytest"},
     {kernmem, "kernmem"},
     {sbrkfail, "sbrkfail"},
     {sbrkarg, "sbrkarg"},
@@ -2684,7 +3741,22 @@ main(int argc, char *argv[])
     {exitiputtest, "exitiput"},
     {iputtest, "iput"},
     {mem, "mem"},
+    {malloctest, "malloctest"},
+    {slabtest, "slabtest"},
     {pipe1, "pipe1"},
+    {pipesize, "pipesize"},
+    {splicetest, "splicetest"},
+    {tmpfstest, "tmpfstest"},
+    {iovtest, "iovtest"},
+    {seektest, "seektest"},
+    {ringtest, "ringtest"},
+    {ringpolltest, "ringpolltest"},
+    {polltest, "polltest"},
+    {getdentstest, "getdentstest"},
+    {clocktest, "clocktest"},
+    {idletest, "idletest"},
+    {sysstattest, "sysstattest"},
+    {tracetest, "tracetest"},
     {preempt, "preempt"},
     {exitwait, "exitwait"},
     {rmdot, "rmdot"},
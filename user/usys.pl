@@ -6,24 +6,27 @@ print "# generated by usys.pl - do not edit\n";
 
 print "#include \"kernel/syscall.h\"\n";
 
+# entry("exit", "_exit") names the stub _exit, leaving
+# exit() to a wrapper in ulib.c.
 sub entry {
     my $name = shift;
-    print ".global $name\n";
-    print "${name}:\n";
+    my $sym = shift || $name;
+    print ".global $sym\n";
+    print "${sym}:\n";
     print " li a7, SYS_${name}\n";
     print " ecall\n";
     print " ret\n";
 }
 	
-entry("fork");
-entry("exit");
+entry("fork", "_fork");
+entry("exit", "_exit");
 entry("wait");
 entry("pipe");
 entry("read");
 entry("write");
-entry("close");
+entry("close", "_close");
 entry("kill");
-entry("exec");
+entry("exec", "_exec");
 entry("open");
 entry("mknod");
 entry("unlink");
@@ -36,3 +39,20 @@ entry("getpid");
 entry("sbrk");
 entry("sleep");
 entry("uptime");
+entry("sysstat");
+entry("tracectl");
+entry("traceread");
+entry("fcntl");
+entry("splice");
+entry("mount");
+entry("readv");
+entry("writev");
+entry("pread");
+entry("pwrite");
+entry("lseek");
+entry("ringsetup");
+entry("ringenter");
+entry("poll");
+entry("getdents");
+entry("clock_gettime");
+entry("idletime");